@@ -0,0 +1,281 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cstdio>
+#include <limits>
+#include <algorithm>
+#include <filesystem>
+#include "component/camera.hpp"
+#include "load/context.hpp"
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// 性能基准: 在无窗口模式下以固定的分辨率、采样数与种子渲染一组场景，
+// 每个场景依次使用 1, 2, 4, ... N 个线程渲染，结果以JSON与CSV输出，作为性能回归的基线
+
+using namespace anya;
+
+// 基准参数，未指定的项使用默认值
+struct BenchOptions {
+    std::vector<std::string> scenes;  // 场景配置，为空时使用sceneDir下所有光线追踪场景
+    std::string sceneDir = "../art/context";
+    int size = 256;                   // 输出图片边长
+    int spp = 4;                      // 每像素采样数
+    std::uint32_t seed = 1;           // 随机数种子
+    int repeat = 1;                   // 每个配置重复渲染的次数，取最短耗时
+    std::vector<int> threads;         // 线程数列表，为空时使用 1, 2, 4, ... N
+    std::string jsonPath = "bench.json";
+    std::string csvPath = "bench.csv";
+};
+
+// 一次渲染的结果
+struct BenchResult {
+    std::string scene;
+    std::string renderer;
+    int threads = 0;
+    double loadSeconds = 0.0;         // 加载场景的耗时，包含BVH构建
+    double bvhSeconds = 0.0;          // 其中BVH构建的耗时
+    double renderSeconds = 0.0;
+    long long rays = 0;               // 追踪的光线数，光栅化或关闭渲染统计时为0
+    double mraysPerSecond = 0.0;
+    double samplesPerSecond = 0.0;
+    double speedup = 1.0;             // 相对单线程的加速比
+    double peakRssMB = 0.0;           // 加载与渲染该场景期间的峰值常驻内存
+    RenderStats stats{};              // 渲染统计，与线程数无关
+};
+
+#pragma region 峰值内存
+// Linux下向/proc/self/clear_refs写入5可以重置峰值常驻内存，使每个场景单独统计；其他平台只能得到进程的历史峰值
+void resetPeakRss() {
+#if defined(__linux__)
+    std::ofstream("/proc/self/clear_refs") << "5";
+#endif
+}
+
+double peakRssMB() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters{};
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+#else
+#if defined(__linux__)
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("VmHWM:", 0) == 0) {
+            return std::stod(line.substr(6)) / 1024.0;
+        }
+    }
+#endif
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+    return usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+    return usage.ru_maxrss / 1024.0;
+#endif
+#endif
+}
+#pragma endregion
+
+#pragma region 参数解析
+std::vector<int> parseList(const std::string& text) {
+    std::vector<int> ret;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        ret.push_back(std::stoi(item));
+    }
+    return ret;
+}
+
+void usage() {
+    std::cerr << "usage: bench [scene.json ...] [--size N] [--spp N] [--seed N] [--repeat N]"
+                 " [--threads 1,2,4] [--json bench.json] [--csv bench.csv]" << std::endl;
+}
+
+bool parseOptions(int argc, char** argv, BenchOptions& options) {
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            auto next = [&]() -> std::string {
+                if (i + 1 >= argc) throw std::invalid_argument("missing value for " + arg);
+                return argv[++i];
+            };
+            if (arg == "--size") options.size = std::stoi(next());
+            else if (arg == "--spp") options.spp = std::stoi(next());
+            else if (arg == "--seed") options.seed = static_cast<std::uint32_t>(std::stoul(next()));
+            else if (arg == "--repeat") options.repeat = std::max(1, std::stoi(next()));
+            else if (arg == "--threads") options.threads = parseList(next());
+            else if (arg == "--json") options.jsonPath = next();
+            else if (arg == "--csv") options.csvPath = next();
+            else if (arg == "-h" || arg == "--help") return false;
+            else if (!arg.empty() && arg[0] == '-') throw std::invalid_argument("unknown option " + arg);
+            else options.scenes.push_back(arg);
+        }
+    } catch (const std::exception& err) {
+        std::cerr << err.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// 缺省的场景列表: sceneDir下所有使用光线追踪渲染器的场景
+std::vector<std::string> defaultScenes(const std::string& dir) {
+    std::vector<std::string> ret;
+    for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+        if (entry.path().extension() != ".json") continue;
+        json config = JsonUtils::load(entry.path().string());
+        std::string type = config["renderer"].value("type", "");
+        if (type == "RayTracer" || type == "WavefrontRayTracer") {
+            ret.push_back(entry.path().generic_string());
+        }
+    }
+    std::sort(ret.begin(), ret.end());
+    return ret;
+}
+
+// 缺省的线程数列表: 1, 2, 4, ... 直到N，N不是2的幂时也包含N
+std::vector<int> defaultThreads() {
+    int maxThreads = omp_get_max_threads();
+    std::vector<int> ret;
+    for (int n = 1; n < maxThreads; n *= 2) ret.push_back(n);
+    ret.push_back(maxThreads);
+    return ret;
+}
+#pragma endregion
+
+// 渲染期间丢弃std::cout的输出(进度条、构建日志)，避免混入基准结果
+struct SilenceGuard {
+    std::ostringstream sink;
+    std::streambuf* old = std::cout.rdbuf(sink.rdbuf());
+    ~SilenceGuard() { std::cout.rdbuf(old); }
+};
+
+// 加载一个场景，并依次使用各个线程数渲染
+bool benchScene(const std::string& path, const BenchOptions& options, std::vector<BenchResult>& results) {
+    json config;
+    try {
+        config = JsonUtils::load(path);
+    } catch (const std::exception& err) {
+        std::cerr << "failed to load " << path << ": " << err.what() << std::endl;
+        return false;
+    }
+    config["camera"]["view_width"] = options.size;
+    config["camera"]["view_height"] = options.size;
+    config["renderer"]["spp"] = options.spp;
+    config["renderer"]["seed"] = options.seed;
+    std::string type = config["renderer"].value("type", "");
+
+    resetPeakRss();
+    Context context;
+    auto start = std::chrono::steady_clock::now();
+    bool loaded;
+    {
+        SilenceGuard guard;
+        loaded = context.loadFromJson(config);
+    }
+    double loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (!loaded) return false;
+    double bvhSeconds = context.bvhBuildSeconds;
+
+    auto& renderer = context._renderer;
+    auto rayTracer = std::dynamic_pointer_cast<RayTracer>(renderer);
+    double samples = double(options.size) * options.size * (rayTracer ? options.spp : 1);
+    double baseline = 0.0;
+    std::size_t first = results.size();
+    for (int threads : options.threads) {
+        renderer->threads = threads;
+        double best = std::numeric_limits<double>::infinity();
+        for (int r = 0; r < options.repeat; ++r) {
+            SilenceGuard guard;
+            auto begin = std::chrono::steady_clock::now();
+            renderer->render();
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+        }
+        if (baseline == 0.0) baseline = best;
+
+        BenchResult result{};
+        result.scene = std::filesystem::path(path).stem().string();
+        result.renderer = type;
+        result.threads = threads;
+        result.loadSeconds = loadSeconds;
+        result.bvhSeconds = bvhSeconds;
+        result.renderSeconds = best;
+        result.stats = renderer->stats;
+        result.rays = renderer->stats.rays();
+        result.mraysPerSecond = result.rays / best * 1e-6;
+        result.samplesPerSecond = samples / best;
+        result.speedup = baseline / best;
+        results.push_back(result);
+    }
+    // 峰值内存覆盖加载与所有线程数的渲染
+    double peak = peakRssMB();
+    for (std::size_t i = first; i < results.size(); ++i) results[i].peakRssMB = peak;
+    return true;
+}
+
+#pragma region 输出
+void writeJson(const std::string& path, const BenchOptions& options, const std::vector<BenchResult>& results) {
+    json ret;
+    ret["size"] = options.size;
+    ret["spp"] = options.spp;
+    ret["seed"] = options.seed;
+    ret["repeat"] = options.repeat;
+    ret["results"] = json::array();
+    for (const auto& r : results) {
+        ret["results"].push_back({
+            { "scene", r.scene }, { "renderer", r.renderer }, { "threads", r.threads },
+            { "load_s", r.loadSeconds }, { "bvh_s", r.bvhSeconds }, { "render_s", r.renderSeconds },
+            { "rays", r.rays }, { "mrays_per_s", r.mraysPerSecond }, { "samples_per_s", r.samplesPerSecond },
+            { "speedup", r.speedup }, { "peak_rss_mb", r.peakRssMB }, { "stats", r.stats.toJson() }
+        });
+    }
+    std::ofstream(path) << ret.dump(2) << std::endl;
+}
+
+void writeCsv(const std::string& path, const std::vector<BenchResult>& results) {
+    std::ofstream ofs(path);
+    ofs << "scene,renderer,threads,load_s,bvh_s,render_s,rays,mrays_per_s,samples_per_s,speedup,peak_rss_mb\n";
+    for (const auto& r : results) {
+        ofs << r.scene << ',' << r.renderer << ',' << r.threads << ','
+            << r.loadSeconds << ',' << r.bvhSeconds << ',' << r.renderSeconds << ','
+            << r.rays << ',' << r.mraysPerSecond << ',' << r.samplesPerSecond << ','
+            << r.speedup << ',' << r.peakRssMB << '\n';
+    }
+}
+#pragma endregion
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        usage();
+        return 1;
+    }
+    if (options.scenes.empty()) options.scenes = defaultScenes(options.sceneDir);
+    if (options.threads.empty()) options.threads = defaultThreads();
+
+    std::vector<BenchResult> results;
+    bool ok = true;
+    for (const auto& scene : options.scenes) {
+        ok = benchScene(scene, options, results) && ok;
+    }
+    writeJson(options.jsonPath, options, results);
+    writeCsv(options.csvPath, results);
+
+    std::printf("%-16s %7s %8s %8s %9s %10s %12s %8s %9s\n",
+                "scene", "threads", "load_s", "bvh_s", "render_s", "Mrays/s", "samples/s", "speedup", "rss_MB");
+    for (const auto& r : results) {
+        std::printf("%-16s %7d %8.3f %8.3f %9.3f %10.3f %12.0f %8.2f %9.1f\n",
+                    r.scene.c_str(), r.threads, r.loadSeconds, r.bvhSeconds, r.renderSeconds,
+                    r.mraysPerSecond, r.samplesPerSecond, r.speedup, r.peakRssMB);
+    }
+    return ok ? 0 : 1;
+}
@@ -27,25 +27,28 @@ public:
 
 public:
 #pragma region 判断相交
-    // 判断光线是否与包围盒相交
+    // 判断光线在 [ray.tMin, ray.tMax] 内是否与包围盒相交
     [[nodiscard]] bool
     intersect(const Ray& ray) const {
-        const auto& origin = ray.pos;
-        const auto& dir = ray.dir;
-        numberType tEnter = -inf;
-        numberType tExit = inf;
+        numberType tEnter, tExit;
+        return clip(ray, tEnter, tExit);
+    }
+
+    // 区间裁剪: 把光线的有效区间裁剪到包围盒内，相交时写出进入与离开距离，进入距离可用于由近及远的遍历排序
+    // 用光线预计算的invDir与sign选取近面与远面，没有除法与分支
+    // 方向分量为0且起点恰好落在该轴的面上时，0 * inf得到NaN，比较总为假，该轴不收缩区间
+    bool
+    clip(const Ray& ray, numberType& tEnter, numberType& tExit) const {
+        const Vector3* bounds[2] = { &pMin, &pMax };
+        tEnter = ray.tMin;
+        tExit = ray.tMax;
         for (int i = 0; i < 3; ++i) {
-            numberType min = (pMin[i] - origin[i]) / dir[i];
-            numberType max = (pMax[i] - origin[i]) / dir[i];
-            // 这里的光线方向都是位于原点的方向向量
-            // 如果坐标是负的，说明光线方向是反的，所以最大和最小的两个角刚好是反过来的
-            if (dir[i] < 0) {
-                std::swap(min, max);
-            }
-            tEnter = std::max(min, tEnter);
-            tExit = std::min(max, tExit);
+            numberType tNear = ((*bounds[ray.sign[i]])[i] - ray.pos[i]) * ray.invDir[i];
+            numberType tFar = ((*bounds[1 - ray.sign[i]])[i] - ray.pos[i]) * ray.invDir[i];
+            tEnter = tNear > tEnter ? tNear : tEnter;
+            tExit = tFar < tExit ? tFar : tExit;
         }
-        return tEnter <= tExit && tExit >= 0.0;
+        return tEnter <= tExit;
     }
 #pragma endregion
 
@@ -71,6 +74,23 @@ public:
         ret.pMax = mergeMaxVec3(lhs.pMax, rhs.pMax);
         return ret;
     }
+
+    // 原地合并，避免构造临时包围盒，用于BVH构建等热点循环
+    void
+    expand(const AABB& rhs) {
+        for (int i = 0; i < 3; ++i) {
+            pMin[i] = std::min(pMin[i], rhs.pMin[i]);
+            pMax[i] = std::max(pMax[i], rhs.pMax[i]);
+        }
+    }
+
+    void
+    expand(const Vector3& p) {
+        for (int i = 0; i < 3; ++i) {
+            pMin[i] = std::min(pMin[i], p[i]);
+            pMax[i] = std::max(pMax[i], p[i]);
+        }
+    }
 #pragma endregion
 
 public:
@@ -83,6 +103,14 @@ public:
     [[nodiscard]] Vector3
     diagonal() const { return pMax - pMin; }
 
+    // 返回表面积，用于SAH代价估计
+    [[nodiscard]] numberType
+    surfaceArea() const {
+        Vector3 d = diagonal();
+        if (d.x() < 0 || d.y() < 0 || d.z() < 0) return 0.0;
+        return 2 * (d.x() * d.y() + d.x() * d.z() + d.y() * d.z());
+    }
+
     [[nodiscard]] int
     maxExtent() const {
         Vector3 d = diagonal();
@@ -6,171 +6,879 @@
 #define ANYA_RENDERER_BVH_HPP
 
 #include "accelerator/AABB.hpp"
+#include "tool/stats.hpp"
+#include "tool/profiler.hpp"
 #include <chrono>
 #include <algorithm>
 #include <optional>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <omp.h>
 
 namespace anya {
 
+// BVH构建参数
+struct BVHConfig {
+    int bins = 12;      // SAH分桶数
+    int leafSize = 4;   // 叶子节点的最大图元数
+    int threads = 0;    // 构建线程数, 0表示使用全部核心
+    int width = 4;      // 单光线遍历的BVH宽度: 2为二叉BVH, 4为由二叉BVH坍缩得到的四叉BVH
+};
+
 // 层次包围盒
 class BVH {
 private:
-    // BVH树节点
-    struct BVHNode {
+    // 预先计算好的图元包围盒与质心，构建时不再调用虚函数
+    struct BVHPrimitive {
+        AABB box{};
+        Vector3 centroid{};
+        int index = 0;
+    };
+
+    // 构建阶段使用的临时树节点，构建完成后会被展平为线性数组并释放
+    struct BVHBuildNode {
         AABB box{};
-        std::shared_ptr<BVHNode> left = nullptr;
-        std::shared_ptr<BVHNode> right = nullptr;
-        std::shared_ptr<Object> object = nullptr;
-        numberType area = 0.0;
+        AABB centroidBox{};
+        std::unique_ptr<BVHBuildNode> left = nullptr;
+        std::unique_ptr<BVHBuildNode> right = nullptr;
+        int axis = 0;
+        int firstOffset = 0;   // 叶子节点的第一个图元在划分后图元中的下标
+        int count = 0;         // 叶子节点的图元个数，为0时表示内部节点
+    };
+
+    // SAH分桶
+    struct BVHBin {
+        AABB box{};
+        int count = 0;
+    };
+
+    // 线性布局的BVH节点，按深度优先顺序存放，左孩子紧跟在父节点之后，只需记录右孩子的下标
+    // 包围盒使用单精度并向外取整，保证包围盒仍然是保守的，整个节点恰好32字节
+    struct alignas(32) LinearBVHNode {
+        float pMin[3];
+        float pMax[3];
+        union {
+            std::int32_t primitivesOffset;   // 叶子节点: 第一个图元在primitives中的下标
+            std::int32_t secondChildOffset;  // 内部节点: 右孩子在nodes中的下标
+        };
+        std::uint16_t primitiveCount;        // 图元个数，为0时表示内部节点
+        std::uint8_t axis;                   // 内部节点的划分轴
+        std::uint8_t pad;
+    };
+    static_assert(sizeof(LinearBVHNode) == 32, "LinearBVHNode should be 32 bytes");
+
+    // 由二叉BVH坍缩得到的四叉BVH节点，4个孩子的包围盒按 [轴][孩子] 的SoA布局存放，一组SIMD指令即可测试光线与所有孩子
+    // 孩子不足4个时空槽位的包围盒为空(pMin为+inf, pMax为-inf)，任何光线都不会与之相交，整个节点恰好两个缓存行
+    struct alignas(64) WideBVHNode {
+        float bounds[2][3][4];          // bounds[0]为pMin, bounds[1]为pMax
+        std::int32_t offset[4];         // 内部孩子: 在wideNodes中的下标; 叶子孩子: 第一个图元在primitives中的下标
+        std::uint16_t count[4];         // 叶子孩子的图元个数，为0时表示内部孩子或空槽位
+    };
+    static_assert(sizeof(WideBVHNode) == 128, "WideBVHNode should be 128 bytes");
+
+    // 四叉BVH遍历栈中的一项，记录进入距离，出栈时比当前最近交点更远的直接跳过
+    struct WideStackEntry {
+        std::int32_t offset;
+        std::int32_t count;
+        numberType tEnter;
+    };
+
+    // 广播到4个通道的单条光线，与四叉节点的4个孩子同时做slab测试
+    struct WideRay {
+        Double4 origin[3];
+        Double4 invDir[3];
+        const int* sign;
+        numberType tMin, tMax;
+
+        explicit WideRay(const Ray& ray): sign(ray.sign), tMin(ray.tMin), tMax(ray.tMax) {
+            for (int i = 0; i < 3; ++i) {
+                origin[i] = Double4(ray.pos[i]);
+                invDir[i] = Double4(ray.invDir[i]);
+            }
+        }
     };
 
 public:
-    std::vector<std::shared_ptr<Object>> rawData;  // 原始的对象
-    std::shared_ptr<BVHNode> root;                 // BVH树根节点
+    // 遍历栈的深度上限，也是构建时树深度的上限，四叉BVH每层最多多压入3个孩子
+    static constexpr int maxStackDepth = 64;
+    static constexpr int maxWideStackDepth = 3 * maxStackDepth + 1;
+
+private:
+    // SAH代价模型中遍历一个内部节点与测试一个图元的相对代价
+    static constexpr numberType traversalCost = 0.125;
+    static constexpr numberType intersectCost = 1.0;
+    // 子树图元数不小于该值时作为任务并行构建
+    static constexpr int parallelTaskThreshold = 4096;
+    // 节点图元数不小于该值时并行计算包围盒与分桶
+    static constexpr int parallelBinThreshold = 65536;
 
 public:
-    explicit BVH(std::vector<std::shared_ptr<Object>>& objs): rawData(objs) {
+    std::vector<std::shared_ptr<Object>> primitives;  // 按叶子顺序重排后的对象，按包围盒构建时为空
+    std::vector<LinearBVHNode> nodes;                 // 深度优先顺序的线性节点数组，光线包遍历始终使用二叉节点
+    std::vector<WideBVHNode> wideNodes;               // config.width为4时由nodes坍缩得到的四叉节点
+    std::vector<numberType> areaPrefix;               // 图元面积的前缀和，用于按面积采样
+    BVHConfig config{};                               // 构建参数
+    numberType sahCost = 0.0;                         // 整棵树的SAH代价
+    double buildSeconds = 0.0;                        // 构建耗时(秒)
+
+public:
+    // 在对象集合上构建，叶子中的图元通过虚函数求交
+    explicit BVH(const std::vector<std::shared_ptr<Object>>& objs, const BVHConfig& cfg = {}): config(cfg) {
+        normalizeConfig();
+        int count = static_cast<int>(objs.size());
+        std::vector<AABB> bounds(count);
+        #pragma omp parallel for schedule(static) num_threads(config.threads)
+        for (int i = 0; i < count; ++i) {
+            bounds[i] = objs[i]->getBoundingBox();
+        }
+        auto order = build(bounds);
+
+        // 叶子引用的是按order重排后的连续区间，按该顺序重排对象
+        primitives.reserve(count);
+        for (int index : order) {
+            primitives.push_back(objs[index]);
+        }
+        areaPrefix.reserve(primitives.size());
+        numberType areaSum = 0.0;
+        for (const auto& primitive : primitives) {
+            areaSum += primitive->getArea();
+            areaPrefix.push_back(areaSum);
+        }
+    }
+
+    // 只在图元包围盒上构建，不持有图元本身
+    // order[i] 为叶子顺序中第i个图元的原始下标，调用者按该顺序重排自己的图元数据，并在遍历时通过叶子回调求交
+    BVH(const std::vector<AABB>& bounds, std::vector<int>& order, const BVHConfig& cfg = {}): config(cfg) {
+        normalizeConfig();
+        order = build(bounds);
+    }
+
+private:
+    // 将构建参数约束到合法范围
+    void
+    normalizeConfig() {
+        config.bins = std::max(2, config.bins);
+        config.leafSize = std::clamp(config.leafSize, 1, 255);
+        config.threads = config.threads > 0 ? config.threads : omp_get_max_threads();
+        config.width = config.width == 2 ? 2 : 4;
+    }
+
+    // 构建BVH并展平，返回叶子顺序对应的原始图元下标
+    std::vector<int>
+    build(const std::vector<AABB>& bounds) {
+        ProfileScope profile("BVH::build", "bvh");
         auto start = std::chrono::steady_clock::now();
 
-        if (rawData.empty()) return;
-        root = buildTree(rawData);
+        std::vector<int> order;
+        if (bounds.empty()) return order;
+
+        int count = static_cast<int>(bounds.size());
+        std::vector<BVHPrimitive> buildData(count);
+        std::unique_ptr<BVHBuildNode> root;
+
+        #pragma omp parallel num_threads(config.threads)
+        {
+            // 预计算质心
+            #pragma omp for schedule(static)
+            for (int i = 0; i < count; ++i) {
+                buildData[i].box = bounds[i];
+                buildData[i].centroid = bounds[i].centroid();
+                buildData[i].index = i;
+            }
+            // 由一个线程发起递归，子树作为任务分发给线程池
+            #pragma omp single
+            root = buildTree(buildData, 0, count, 0);
+        }
+
+        order.reserve(count);
+        for (const auto& primitive : buildData) {
+            order.push_back(primitive.index);
+        }
+        nodes.reserve(2 * bounds.size() - 1);
+        numberType rootArea = root->box.surfaceArea();
+        flatten(root.get(), rootArea > 0 ? 1.0 / rootArea : 0.0);
+        root.reset();
+        if (config.width == 4) {
+            wideNodes.reserve(nodes.size() / 2 + 1);
+            collapse(0);
+        }
 
         auto end = std::chrono::steady_clock::now();
         auto time_diff = end - start;
+        buildSeconds = std::chrono::duration<double>(time_diff).count();
         auto hours = std::chrono::duration_cast<std::chrono::hours>(time_diff);
         auto minutes = std::chrono::duration_cast<std::chrono::minutes>(time_diff - hours);
         auto seconds = std::chrono::duration_cast<std::chrono::seconds>(time_diff - hours - minutes);
+        auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(time_diff - hours - minutes - seconds);
 
-        std::cout << "\rBVH Generation Complete! \nTime Taken: " <<  hours.count() << " hours, " << minutes.count() << " minutes, " << seconds.count() << " seconds\n\n";
+        std::cout << "\rBVH Generation Complete! \nPrimitives: " << count
+                  << ", Nodes: " << nodes.size() << " (" << nodes.size() * sizeof(LinearBVHNode) / 1024.0 << " KB)"
+                  << ", Wide Nodes: " << wideNodes.size() << " (" << wideNodes.size() * sizeof(WideBVHNode) / 1024.0 << " KB)"
+                  << ", SAH Cost: " << sahCost
+                  << "\nThreads: " << config.threads << ", Throughput: " << static_cast<long long>(count / std::max(buildSeconds, 1e-9)) << " prims/s"
+                  << "\nTime Taken: " <<  hours.count() << " hours, " << minutes.count() << " minutes, " << seconds.count() << " seconds, " << milliseconds.count() << " milliseconds\n\n";
+        return order;
     }
 
-    static std::shared_ptr<BVHNode>
-    buildTree(std::vector<std::shared_ptr<Object>> objects) {
-        auto node = std::make_shared<BVHNode>();
-        AABB box{};
-        for (const auto& object : objects) {
-            box = AABB::merge(box, object->getBoundingBox());
-        }
-        if (objects.size() == 1) {
-            node->box = objects[0]->getBoundingBox();
-            node->object = objects[0];
-            node->left = nullptr;
-            node->right = nullptr;
-            node->area = objects[0]->getArea();
-            return node;
-        }
-        else if (objects.size() == 2) {
-            node->left = buildTree(std::vector{objects[0]});
-            node->right = buildTree(std::vector{objects[1]});
-            node->box = AABB::merge(node->left->box, node->right->box);
-            node->area = node->left->area + node->right->area;
-            return node;
+private:
+    // 在 [begin, end) 范围内递归构建，原地划分buildData，叶子直接引用划分后的连续区间
+    // 规模较大的子树作为OpenMP任务并行构建，由于叶子不依赖构建顺序，结果与线程数无关
+    // 深度接近maxStackDepth时改为按中位数划分，剩余层数足够把图元对半分到底，遍历栈不会溢出
+    std::unique_ptr<BVHBuildNode>
+    buildTree(std::vector<BVHPrimitive>& buildData, int begin, int end, int depth) const {
+        auto node = std::make_unique<BVHBuildNode>();
+        std::tie(node->box, node->centroidBox) = computeBounds(buildData, begin, end);
+        const AABB& centroidBox = node->centroidBox;
+
+        int count = end - begin;
+        auto makeLeaf = [&]() {
+            assert(depth <= maxStackDepth);
+            node->firstOffset = begin;
+            node->count = count;
+            return std::move(node);
+        };
+        if (count == 1) {
+            return makeLeaf();
+        }
+
+        int dim = centroidBox.maxExtent();
+        node->axis = dim;
+        int mid = (begin + end) / 2;
+
+        if (centroidBox.pMax[dim] <= centroidBox.pMin[dim]) {
+            // 质心全部重合，SAH无法划分，数量不多时直接作为叶子，否则从中间一分为二
+            if (count <= config.leafSize) {
+                return makeLeaf();
+            }
+        }
+        else if (depth + 1 + std::bit_width(static_cast<unsigned>(count - 1)) > maxStackDepth) {
+            // SAH划分可能很不均衡，剩余层数只够中位数划分，对半划分的子树还需 ceil(log2(count)) 层
+            if (count <= config.leafSize) {
+                return makeLeaf();
+            }
+            std::nth_element(buildData.begin() + begin, buildData.begin() + mid, buildData.begin() + end,
+                             [dim](const BVHPrimitive& a, const BVHPrimitive& b) {
+                                 return a.centroid[dim] < b.centroid[dim];
+                             });
         }
         else {
-            AABB centroidBox{};
-            for (const auto& object : objects) {
-                centroidBox = AABB::merge(centroidBox, object->getBoundingBox().centroid());
+            auto [axis, bin, cost] = findSplit(buildData, begin, end, node->box, centroidBox);
+            if (count <= config.leafSize && cost >= intersectCost * count) {
+                return makeLeaf();
+            }
+            node->axis = axis;
+            numberType min = centroidBox.pMin[axis];
+            numberType scale = binScale(centroidBox, axis);
+            auto it = std::partition(buildData.begin() + begin, buildData.begin() + end, [&](const BVHPrimitive& p) {
+                return binIndex(p.centroid[axis], min, scale) <= bin;
+            });
+            mid = static_cast<int>(it - buildData.begin());
+            // 划分退化时退回到按质心中位数划分
+            if (mid == begin || mid == end) {
+                mid = (begin + end) / 2;
+                std::nth_element(buildData.begin() + begin, buildData.begin() + mid, buildData.begin() + end,
+                                 [axis](const BVHPrimitive& a, const BVHPrimitive& b) {
+                                     return a.centroid[axis] < b.centroid[axis];
+                                 });
             }
+        }
+
+        if (config.threads > 1 && count >= parallelTaskThreshold) {
+            #pragma omp task default(none) shared(node, buildData) firstprivate(begin, mid, depth)
+            node->left = buildTree(buildData, begin, mid, depth + 1);
+            #pragma omp task default(none) shared(node, buildData) firstprivate(mid, end, depth)
+            node->right = buildTree(buildData, mid, end, depth + 1);
+            #pragma omp taskwait
+        }
+        else {
+            node->left = buildTree(buildData, begin, mid, depth + 1);
+            node->right = buildTree(buildData, mid, end, depth + 1);
+        }
+        return node;
+    }
 
-            int dim = centroidBox.maxExtent();
+    // 计算 [begin, end) 的包围盒与质心包围盒
+    [[nodiscard]] std::pair<AABB, AABB>
+    computeBounds(const std::vector<BVHPrimitive>& buildData, int begin, int end) const {
+        return reduceRange(begin, end, std::pair<AABB, AABB>{},
+            [&](std::pair<AABB, AABB>& bounds, int i) {
+                bounds.first.expand(buildData[i].box);
+                bounds.second.expand(buildData[i].centroid);
+            },
+            [](std::pair<AABB, AABB>& lhs, const std::pair<AABB, AABB>& rhs) {
+                lhs.first.expand(rhs.first);
+                lhs.second.expand(rhs.second);
+            });
+    }
 
-            switch (dim) {
-                case 0: {
-                    auto cmp = [](const auto& a, const auto& b) {
-                        return a->getBoundingBox().centroid().x() <
-                               b->getBoundingBox().centroid().x();
-                    };
-                    std::sort(objects.begin(), objects.end(), cmp);
-                    break;
+    // 在三个轴上分桶，返回SAH代价最小的划分轴、划分桶(包含该桶及其左侧的桶)与代价
+    [[nodiscard]] std::tuple<int, int, numberType>
+    findSplit(const std::vector<BVHPrimitive>& buildData, int begin, int end, const AABB& box, const AABB& centroidBox) const {
+        int bestAxis = 0, bestBin = 0;
+        numberType bestCost = KMAX;
+        numberType invArea = 1.0 / std::max(box.surfaceArea(), epsilon);
+
+        // 三个轴的桶连续存放，第axis个轴的桶为 [axis * bins, (axis + 1) * bins)
+        // 质心范围为0的轴scale为0，所有图元都落在第一个桶中，不会被选为划分轴
+        int binCount = config.bins;
+        numberType min[3], scale[3];
+        for (int axis = 0; axis < 3; ++axis) {
+            min[axis] = centroidBox.pMin[axis];
+            scale[axis] = binScale(centroidBox, axis);
+        }
+        auto bins = reduceRange(begin, end, std::vector<BVHBin>(3 * binCount),
+            [&](std::vector<BVHBin>& local, int i) {
+                const auto& primitive = buildData[i];
+                for (int axis = 0; axis < 3; ++axis) {
+                    auto& b = local[axis * binCount + binIndex(primitive.centroid[axis], min[axis], scale[axis])];
+                    ++b.count;
+                    b.box.expand(primitive.box);
                 }
-                case 1: {
-                    auto cmp = [](const auto& a, const auto& b) {
-                        return a->getBoundingBox().centroid().y() <
-                               b->getBoundingBox().centroid().y();
-                    };
-                    std::sort(objects.begin(), objects.end(), cmp);
-                    break;
+            },
+            [](std::vector<BVHBin>& lhs, const std::vector<BVHBin>& rhs) {
+                for (std::size_t k = 0; k < lhs.size(); ++k) {
+                    lhs[k].count += rhs[k].count;
+                    lhs[k].box.expand(rhs[k].box);
                 }
-                case 2: {
-                    auto cmp = [](const auto& a, const auto& b) {
-                        return a->getBoundingBox().centroid().z() <
-                               b->getBoundingBox().centroid().z();
-                    };
-                    std::sort(objects.begin(), objects.end(), cmp);
-                    break;
+            });
+
+        std::vector<numberType> rightCost(binCount);
+        for (int axis = 0; axis < 3; ++axis) {
+            if (centroidBox.pMax[axis] <= centroidBox.pMin[axis]) continue;
+            const BVHBin* axisBins = bins.data() + axis * binCount;
+            // 从右往左扫描得到每个划分右侧的代价
+            AABB rightBox{};
+            int rightCount = 0;
+            for (int i = binCount - 1; i > 0; --i) {
+                rightBox.expand(axisBins[i].box);
+                rightCount += axisBins[i].count;
+                rightCost[i - 1] = rightCount * rightBox.surfaceArea();
+            }
+            // 从左往右扫描并计算总代价
+            AABB leftBox{};
+            int leftCount = 0;
+            for (int i = 0; i < binCount - 1; ++i) {
+                leftBox.expand(axisBins[i].box);
+                leftCount += axisBins[i].count;
+                numberType cost = traversalCost + intersectCost * (leftCount * leftBox.surfaceArea() + rightCost[i]) * invArea;
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = i;
                 }
-                default:
-                    throw std::runtime_error("Should not get here!");
             }
+        }
+        return { bestAxis, bestBin, bestCost };
+    }
 
-            auto begin = objects.begin();
-            auto end = objects.end();
-            auto mid = begin + (objects.size() / 2);
-
-            auto leftBox = std::vector<std::shared_ptr<Object>>(begin, mid);
-            auto rightBox = std::vector<std::shared_ptr<Object>>(mid, end);
+    // 对 [begin, end) 做归约，规模较大时切分为若干块，以任务的形式并行累加后再按块的顺序合并
+    template<class T, class Accumulate, class Merge>
+    [[nodiscard]] T
+    reduceRange(int begin, int end, T init, Accumulate accumulate, Merge merge) const {
+        int count = end - begin;
+        if (config.threads <= 1 || count < parallelBinThreshold) {
+            for (int i = begin; i < end; ++i) accumulate(init, i);
+            return init;
+        }
+        int chunks = std::min(4 * config.threads, count / (parallelBinThreshold / 4));
+        std::vector<T> partial(chunks, init);
+        #pragma omp taskloop default(none) shared(partial, accumulate) firstprivate(begin, count, chunks) grainsize(1)
+        for (int c = 0; c < chunks; ++c) {
+            int first = begin + static_cast<int>(static_cast<long long>(count) * c / chunks);
+            int last = begin + static_cast<int>(static_cast<long long>(count) * (c + 1) / chunks);
+            for (int i = first; i < last; ++i) accumulate(partial[c], i);
+        }
+        for (int c = 1; c < chunks; ++c) merge(partial[0], partial[c]);
+        return partial[0];
+    }
 
-            if (objects.size() != leftBox.size() + rightBox.size())
-                throw std::runtime_error("Error when build BVH tree!");
+    // 质心坐标到桶下标的缩放系数
+    [[nodiscard]] numberType
+    binScale(const AABB& centroidBox, int axis) const {
+        numberType extent = centroidBox.pMax[axis] - centroidBox.pMin[axis];
+        return extent > 0 ? config.bins / extent : 0.0;
+    }
 
-            node->left = buildTree(leftBox);
-            node->right = buildTree(rightBox);
-            node->box = AABB::merge(node->left->box, node->right->box);
-            node->area = node->left->area + node->right->area;
-        }
-        return node;
+    // 质心坐标落在哪个桶
+    [[nodiscard]] int
+    binIndex(numberType centroid, numberType min, numberType scale) const {
+        return std::min(static_cast<int>((centroid - min) * scale), config.bins - 1);
     }
 
 public:
+    // 最近交点查询，用显式栈迭代遍历，先访问离光线起点更近的孩子，并剔除比当前最近交点更远的子树
     [[nodiscard]] std::optional<HitData>
     intersect(const Ray& ray) const {
-        std::optional<HitData> hitData;
-        hitData = getIntersect(root, ray);
-        return hitData;
+        HitRecord rec{};
+        if (!intersect(ray, rec)) return {};
+        return rec.resolve(ray);
+    }
+
+    // 最近交点查询，只更新轻量的相交记录，rec.t同时作为遍历的上限
+    bool
+    intersect(const Ray& ray, HitRecord& rec) const {
+        return intersect(ray, rec.t, [&](int first, int count, numberType&) {
+            bool hit = false;
+            for (int i = first; i < first + count; ++i) {
+                hit |= primitives[i]->intersect(ray, rec);
+            }
+            return hit;
+        });
+    }
+
+    // 可见性查询，找到 (0, tMax) 内的任意一个交点即返回，不构造HitData
+    [[nodiscard]] bool
+    occluded(const Ray& ray, numberType tMax) const {
+        return occluded(ray, tMax, [&](int first, int count) {
+            for (int i = first; i < first + count; ++i) {
+                if (primitives[i]->occludes(ray, tMax)) return true;
+            }
+            return false;
+        });
+    }
+
+    // 光线包的最近交点查询，命中时更新recs与packet.tMax的对应通道
+    void
+    intersect(RayPacket& packet, HitRecord* recs) const {
+        intersect(packet, packet.active, [&](int first, int count, int mask) {
+            for (int i = first; i < first + count; ++i) {
+                primitives[i]->intersect(packet, recs, mask);
+            }
+        });
     }
 
+    // 光线包的可见性查询，返回被遮挡的光线的掩码
+    [[nodiscard]] int
+    occluded(const RayPacket& packet) const {
+        return occluded(packet, packet.active, [&](int first, int count, int mask) {
+            int ret = 0;
+            for (int i = first; i < first + count && mask != 0; ++i) {
+                int hit = primitives[i]->occludes(packet, mask);
+                ret |= hit;
+                mask &= ~hit;
+            }
+            return ret;
+        });
+    }
+
+    // 以叶子回调的方式做最近交点查询，按config.width选择二叉或四叉BVH
+    // leaf(first, count, tMax) 测试叶子顺序中 [first, first + count) 的图元，找到更近的交点时更新tMax并返回true
+    template<class LeafIntersect>
+    bool
+    intersect(const Ray& ray, numberType& tMax, LeafIntersect&& leaf) const {
+        return config.width == 4 ? intersectWide(ray, tMax, leaf) : intersectBinary(ray, tMax, leaf);
+    }
+
+    // 以叶子回调的方式做可见性查询，按config.width选择二叉或四叉BVH
+    // leaf(first, count) 在 [first, first + count) 中找到 (0, tMax) 内的任意交点时返回true，遍历随即终止
+    template<class LeafOcclude>
+    bool
+    occluded(const Ray& ray, numberType tMax, LeafOcclude&& leaf) const {
+        return config.width == 4 ? occludedWide(ray, tMax, leaf) : occludedBinary(ray, tMax, leaf);
+    }
+
+    // 以叶子回调的方式做光线包的最近交点查询
+    // 每个节点用一组SIMD指令同时测试mask中的所有光线，只要有一条光线与包围盒相交就进入该节点，
+    // 孩子的访问顺序由第一条有效光线的方向决定，包内光线方向一致时与逐条遍历的顺序相同
+    // leaf(first, count, laneMask) 对laneMask中的光线测试叶子中的图元，找到更近的交点时缩小packet.tMax
+    template<class LeafIntersect>
+    void
+    intersect(const RayPacket& packet, int mask, LeafIntersect&& leaf) const {
+        if (nodes.empty() || mask == 0) return;
+
+        int lead = std::countr_zero(static_cast<unsigned>(mask));
+        int dirIsNeg[3] = { packet.invDir[0][lead] < 0.0, packet.invDir[1][lead] < 0.0, packet.invDir[2][lead] < 0.0 };
+
+        int stack[maxStackDepth];
+        int top = 0;
+        int current = 0;
+        while (true) {
+            const auto& node = nodes[current];
+            countVisit(std::popcount(static_cast<unsigned>(mask)));
+            int laneMask = intersectBox(node, packet) & mask;
+            if (laneMask != 0 && node.primitiveCount == 0) {
+                if (dirIsNeg[node.axis]) {
+                    stack[top++] = current + 1;
+                    current = node.secondChildOffset;
+                }
+                else {
+                    stack[top++] = node.secondChildOffset;
+                    current = current + 1;
+                }
+                continue;
+            }
+            if (laneMask != 0) {
+                leaf(node.primitivesOffset, node.primitiveCount, laneMask);
+            }
+            if (top == 0) break;
+            current = stack[--top];
+        }
+    }
+
+    // 以叶子回调的方式做光线包的可见性查询，返回被遮挡的光线的掩码，mask中的光线全部被遮挡时提前结束
+    // leaf(first, count, laneMask) 返回laneMask中在 (0, tMax) 内被叶子中的图元遮挡的光线
+    template<class LeafOcclude>
+    int
+    occluded(const RayPacket& packet, int mask, LeafOcclude&& leaf) const {
+        if (nodes.empty() || mask == 0) return 0;
+
+        int lead = std::countr_zero(static_cast<unsigned>(mask));
+        int dirIsNeg[3] = { packet.invDir[0][lead] < 0.0, packet.invDir[1][lead] < 0.0, packet.invDir[2][lead] < 0.0 };
+        int ret = 0;
+
+        int stack[maxStackDepth];
+        int top = 0;
+        int current = 0;
+        while (true) {
+            const auto& node = nodes[current];
+            countVisit(std::popcount(static_cast<unsigned>(mask)));
+            int laneMask = intersectBox(node, packet) & mask;
+            if (laneMask != 0 && node.primitiveCount == 0) {
+                if (dirIsNeg[node.axis]) {
+                    stack[top++] = current + 1;
+                    current = node.secondChildOffset;
+                }
+                else {
+                    stack[top++] = node.secondChildOffset;
+                    current = current + 1;
+                }
+                continue;
+            }
+            if (laneMask != 0) {
+                int hit = leaf(node.primitivesOffset, node.primitiveCount, laneMask);
+                ret |= hit;
+                mask &= ~hit;
+                if (mask == 0) break;
+            }
+            if (top == 0) break;
+            current = stack[--top];
+        }
+        return ret;
+    }
+
+    // 按面积在所有图元上均匀采样
     [[nodiscard]] std::pair<HitData, numberType>
-    sample() const {
-        auto p = std::sqrt(MathUtils::getRandNum()) * root->area;
-        auto [pos, pdf] = getSample(root, p);
-        pdf /= root->area;
+    sample(Sampler& sampler) const {
+        numberType area = areaPrefix.back();
+        auto p = sampler.get1D() * area;
+        auto it = std::upper_bound(areaPrefix.begin(), areaPrefix.end(), p);
+        auto index = std::min<std::size_t>(it - areaPrefix.begin(), primitives.size() - 1);
+        auto [pos, pdf] = primitives[index]->sample(sampler);
+        // 图元内部的面积pdf * 选中该图元的概率
+        pdf *= primitives[index]->getArea() / area;
         return { pos, pdf };
     }
 
 private:
-    [[nodiscard]] std::optional<HitData>
-    getIntersect(const std::shared_ptr<BVHNode>& node, const Ray& ray) const {
-        // 没有交点，直接返回
-        if (!node->box.intersect(ray)) {
-            return {};
+    // 二叉BVH的最近交点查询，用显式栈迭代遍历，近的孩子先访问
+    template<class LeafIntersect>
+    bool
+    intersectBinary(const Ray& ray, numberType& tMax, LeafIntersect& leaf) const {
+        if (nodes.empty()) return false;
+
+        bool hit = false;
+
+        int stack[maxStackDepth];
+        int top = 0;
+        int current = 0;
+        while (true) {
+            const auto& node = nodes[current];
+            countVisit(1);
+            if (intersectBox(node, ray, tMax)) {
+                if (node.primitiveCount > 0) {
+                    // 叶子节点，逐个测试图元
+                    hit |= leaf(node.primitivesOffset, node.primitiveCount, tMax);
+                    if (top == 0) break;
+                    current = stack[--top];
+                }
+                else {
+                    // 内部节点，近的孩子先访问，远的孩子入栈
+                    if (ray.sign[node.axis]) {
+                        stack[top++] = current + 1;
+                        current = node.secondChildOffset;
+                    }
+                    else {
+                        stack[top++] = node.secondChildOffset;
+                        current = current + 1;
+                    }
+                }
+            }
+            else {
+                if (top == 0) break;
+                current = stack[--top];
+            }
         }
-        // 叶子结点且有交点 直接返回
-        if (node->left == nullptr && node->right == nullptr) {
-            return node->object->getIntersect(ray);
+        return hit;
+    }
+
+    // 二叉BVH的可见性查询
+    template<class LeafOcclude>
+    bool
+    occludedBinary(const Ray& ray, numberType tMax, LeafOcclude& leaf) const {
+        if (nodes.empty()) return false;
+
+
+        int stack[maxStackDepth];
+        int top = 0;
+        int current = 0;
+        while (true) {
+            const auto& node = nodes[current];
+            countVisit(1);
+            if (intersectBox(node, ray, tMax)) {
+                if (node.primitiveCount > 0) {
+                    if (leaf(node.primitivesOffset, node.primitiveCount)) {
+                        return true;
+                    }
+                    if (top == 0) break;
+                    current = stack[--top];
+                }
+                else {
+                    if (ray.sign[node.axis]) {
+                        stack[top++] = current + 1;
+                        current = node.secondChildOffset;
+                    }
+                    else {
+                        stack[top++] = node.secondChildOffset;
+                        current = current + 1;
+                    }
+                }
+            }
+            else {
+                if (top == 0) break;
+                current = stack[--top];
+            }
         }
+        return false;
+    }
 
-        auto lchild = getIntersect(node->left, ray);
-        auto rchild = getIntersect(node->right, ray);
+    // 四叉BVH的最近交点查询，一次测试光线与节点的4个孩子，最近的孩子直接访问，其余孩子按进入距离从远到近入栈
+    // 大多数节点只有1~2个孩子相交，只在3个以上时才做插入排序
+    template<class LeafIntersect>
+    bool
+    intersectWide(const Ray& ray, numberType& tMax, LeafIntersect& leaf) const {
+        if (wideNodes.empty()) return false;
 
-        auto ldistance = lchild.has_value() ? lchild->tNear : KMAX;
-        auto rdistance = rchild.has_value() ? rchild->tNear : KMAX;
+        WideRay wideRay(ray);
+        bool hit = false;
 
-        return ldistance < rdistance ? lchild : rchild;
+        WideStackEntry stack[maxWideStackDepth];
+        int top = 0;
+        WideStackEntry current{ 0, 0, -inf };
+        while (true) {
+            if (current.count > 0) {
+                hit |= leaf(current.offset, current.count, tMax);
+            }
+            else {
+                const auto& node = wideNodes[current.offset];
+                countVisit(4);
+                alignas(32) numberType tEnter[4];
+                int mask = intersectBoxes(node, wideRay, tMax, tEnter);
+                if (mask != 0) {
+                    auto child = [&](int k) { return WideStackEntry{ node.offset[k], node.count[k], tEnter[k] }; };
+                    int k = std::countr_zero(static_cast<unsigned>(mask));
+                    mask &= mask - 1;
+                    current = child(k);
+                    if (mask == 0) continue;
+
+                    // 当前栈顶之上为本节点的孩子，按进入距离从远到近排列，current始终是最近的孩子
+                    int base = top;
+                    for (; mask != 0; mask &= mask - 1) {
+                        auto entry = child(std::countr_zero(static_cast<unsigned>(mask)));
+                        if (entry.tEnter < current.tEnter) std::swap(entry, current);
+                        int j = top++;
+                        for (; j > base && stack[j - 1].tEnter < entry.tEnter; --j) {
+                            stack[j] = stack[j - 1];
+                        }
+                        stack[j] = entry;
+                    }
+                    continue;
+                }
+            }
+            // 出栈时跳过比当前最近交点更远的孩子
+            do {
+                if (top == 0) return hit;
+                current = stack[--top];
+            } while (current.tEnter > tMax);
+        }
     }
 
-    [[nodiscard]] std::pair<HitData, numberType>
-    getSample(const std::shared_ptr<BVHNode>& node, numberType p) const {
-        if (node->left == nullptr || node->right == nullptr) {
-            auto [pos, pdf] = node->object->sample();
-            pdf *= node->area;
-            return { pos, pdf };
+    // 四叉BVH的可见性查询，任意交点即可终止，孩子不排序
+    template<class LeafOcclude>
+    bool
+    occludedWide(const Ray& ray, numberType tMax, LeafOcclude& leaf) const {
+        if (wideNodes.empty()) return false;
+
+        WideRay wideRay(ray);
+
+        WideStackEntry stack[maxWideStackDepth];
+        int top = 0;
+        stack[top++] = { 0, 0, -inf };
+        while (top > 0) {
+            auto entry = stack[--top];
+            if (entry.count > 0) {
+                if (leaf(entry.offset, entry.count)) return true;
+                continue;
+            }
+            const auto& node = wideNodes[entry.offset];
+            countVisit(4);
+            alignas(32) numberType tEnter[4];
+            for (int mask = intersectBoxes(node, wideRay, tMax, tEnter); mask != 0; mask &= mask - 1) {
+                int k = std::countr_zero(static_cast<unsigned>(mask));
+                stack[top++] = { node.offset[k], node.count[k], tEnter[k] };
+            }
         }
-        if (p < node->left->area) {
-            return getSample(node->left, p);
+        return false;
+    }
+
+    // 将构建树按深度优先顺序展平到nodes中，同时累加SAH代价，返回该节点的下标
+    int
+    flatten(const BVHBuildNode* node, numberType invRootArea) {
+        int offset = static_cast<int>(nodes.size());
+        nodes.emplace_back();
+        auto& linear = nodes.back();
+        for (int i = 0; i < 3; ++i) {
+            linear.pMin[i] = roundDown(node->box.pMin[i]);
+            linear.pMax[i] = roundUp(node->box.pMax[i]);
+        }
+        linear.axis = static_cast<std::uint8_t>(node->axis);
+        linear.pad = 0;
+
+        numberType areaRatio = node->box.surfaceArea() * invRootArea;
+        if (node->count > 0) {
+            linear.primitivesOffset = node->firstOffset;
+            linear.primitiveCount = static_cast<std::uint16_t>(node->count);
+            sahCost += intersectCost * node->count * areaRatio;
         }
         else {
-            return getSample(node->right, p - node->left->area);
+            linear.primitiveCount = 0;
+            sahCost += traversalCost * areaRatio;
+            flatten(node->left.get(), invRootArea);
+            // emplace_back可能使引用失效，重新按下标访问
+            nodes[offset].secondChildOffset = flatten(node->right.get(), invRootArea);
+        }
+        return offset;
+    }
+
+    // 将以nodes[index]为根的二叉子树坍缩为四叉节点，返回其在wideNodes中的下标
+    // 每次把孩子中表面积最大的内部节点替换为它的两个孩子，直到凑满4个孩子或只剩叶子
+    int
+    collapse(int index) {
+        int children[4] = { index };
+        int n = 1;
+        while (n < 4) {
+            int best = -1;
+            float bestArea = -1.0f;
+            for (int k = 0; k < n; ++k) {
+                const auto& node = nodes[children[k]];
+                if (node.primitiveCount > 0) continue;
+                float area = surfaceArea(node);
+                if (area > bestArea) {
+                    bestArea = area;
+                    best = k;
+                }
+            }
+            if (best < 0) break;
+            int parent = children[best];
+            children[best] = parent + 1;
+            children[n++] = nodes[parent].secondChildOffset;
+        }
+
+        int offset = static_cast<int>(wideNodes.size());
+        wideNodes.emplace_back();
+        auto& wide = wideNodes.back();
+        for (int k = 0; k < 4; ++k) {
+            for (int axis = 0; axis < 3; ++axis) {
+                wide.bounds[0][axis][k] = k < n ? nodes[children[k]].pMin[axis] : std::numeric_limits<float>::infinity();
+                wide.bounds[1][axis][k] = k < n ? nodes[children[k]].pMax[axis] : -std::numeric_limits<float>::infinity();
+            }
+            bool leaf = k < n && nodes[children[k]].primitiveCount > 0;
+            wide.offset[k] = leaf ? nodes[children[k]].primitivesOffset : 0;
+            wide.count[k] = leaf ? nodes[children[k]].primitiveCount : 0;
+        }
+        for (int k = 0; k < n; ++k) {
+            if (nodes[children[k]].primitiveCount > 0) continue;
+            // emplace_back可能使引用失效，重新按下标访问
+            int child = collapse(children[k]);
+            wideNodes[offset].offset[k] = child;
+        }
+        return offset;
+    }
+
+    [[nodiscard]] static float
+    surfaceArea(const LinearBVHNode& node) {
+        float dx = node.pMax[0] - node.pMin[0];
+        float dy = node.pMax[1] - node.pMin[1];
+        float dz = node.pMax[2] - node.pMin[2];
+        return 2.0f * (dx * dy + dy * dz + dz * dx);
+    }
+
+    // 记录一次节点访问及其中的包围盒测试数
+    static void
+    countVisit(int boxes) {
+        RenderStats::count(&RenderStats::nodesVisited);
+        RenderStats::count(&RenderStats::boxTests, boxes);
+    }
+
+    // 光线与单精度包围盒的slab测试，在 [ray.tMin, min(ray.tMax, tMax)] 内裁剪，与AABB::clip的做法一致
+    // 用光线预计算的invDir与sign选取近面与远面，没有除法与分支，0 * inf产生的NaN不会收缩区间
+    [[nodiscard]] static bool
+    intersectBox(const LinearBVHNode& node, const Ray& ray, numberType tMax) {
+        const float* bounds[2] = { node.pMin, node.pMax };
+        numberType tEnter = ray.tMin;
+        numberType tExit = std::min(tMax, ray.tMax);
+        for (int i = 0; i < 3; ++i) {
+            numberType tNear = (bounds[ray.sign[i]][i] - ray.pos[i]) * ray.invDir[i];
+            numberType tFar = (bounds[1 - ray.sign[i]][i] - ray.pos[i]) * ray.invDir[i];
+            tEnter = tNear > tEnter ? tNear : tEnter;
+            tExit = tFar < tExit ? tFar : tExit;
         }
+        return tEnter <= tExit;
+    }
+
+    // 光线包与单精度包围盒的slab测试，返回相交的通道掩码，每个通道与intersectBox的结果一致
+    // 包内光线方向不一定同号，按每个通道invDir的符号位选取近面与远面
+    [[nodiscard]] static int
+    intersectBox(const LinearBVHNode& node, const RayPacket& packet) {
+        Double4 tEnter(0.0);
+        Double4 tExit = Double4::load(packet.tMax);
+        for (int i = 0; i < 3; ++i) {
+            Double4 origin = Double4::load(packet.origin[i]);
+            Double4 invDir = Double4::load(packet.invDir[i]);
+            Double4 t0 = (Double4(node.pMin[i]) - origin) * invDir;
+            Double4 t1 = (Double4(node.pMax[i]) - origin) * invDir;
+            tEnter = max(tEnter, selectBySign(invDir, t0, t1));
+            tExit = min(tExit, selectBySign(invDir, t1, t0));
+        }
+        return tEnter <= tExit;
+    }
+
+    // 光线与四叉节点4个孩子的slab测试，每个通道与intersectBox的结果一致，返回相交的孩子掩码并写出进入距离
+    [[nodiscard]] static int
+    intersectBoxes(const WideBVHNode& node, const WideRay& ray, numberType tMax, numberType* tEnterOut) {
+        Double4 tEnter(ray.tMin);
+        Double4 tExit(std::min(tMax, ray.tMax));
+        for (int i = 0; i < 3; ++i) {
+            Double4 tNear = (Double4::load(node.bounds[ray.sign[i]][i]) - ray.origin[i]) * ray.invDir[i];
+            Double4 tFar = (Double4::load(node.bounds[1 - ray.sign[i]][i]) - ray.origin[i]) * ray.invDir[i];
+            tEnter = max(tEnter, tNear);
+            tExit = min(tExit, tFar);
+        }
+        tEnter.store(tEnterOut);
+        return tEnter <= tExit;
+    }
+
+    // double转float时向下/向上取整，保证包围盒不会变小
+    static float
+    roundDown(numberType v) {
+        auto f = static_cast<float>(v);
+        return f > v ? std::nextafter(f, -std::numeric_limits<float>::infinity()) : f;
+    }
+
+    static float
+    roundUp(numberType v) {
+        auto f = static_cast<float>(v);
+        return f < v ? std::nextafter(f, std::numeric_limits<float>::infinity()) : f;
     }
 };
 
@@ -0,0 +1,70 @@
+#ifndef ANYA_RENDERER_LIGHT_DISTRIBUTION_HPP
+#define ANYA_RENDERER_LIGHT_DISTRIBUTION_HPP
+
+#include "interface/object.hpp"
+#include "tool/alias_table.hpp"
+
+namespace anya {
+
+// 面光源的采样分布
+// 加载场景时把所有发光物体拆成图元(三角形)收集到一张扁平的表中，按面积构建别名表，
+// 采样时 O(1) 选中一个图元再在其上均匀采样，开销与场景中不发光的物体数量无关
+class LightDistribution {
+private:
+    // 一个发光图元
+    struct Emitter {
+        const Object* object = nullptr;
+        int primId = 0;
+    };
+
+    std::vector<Emitter> emitters;
+    AliasTable table;
+
+public:
+    LightDistribution() = default;
+
+    explicit LightDistribution(const std::vector<std::shared_ptr<Object>>& objects) {
+        std::vector<numberType> areas;
+        for (const auto& object : objects) {
+            if (!object->isLight()) continue;
+            for (int i = 0; i < object->primitiveCount(); ++i) {
+                emitters.push_back({ object.get(), i });
+                areas.push_back(object->primitiveArea(i));
+            }
+        }
+        table = AliasTable(areas);
+    }
+
+public:
+    // 按面积在所有发光图元上均匀采样，返回采样点与其面积pdf，即 1 / 发光总面积
+    [[nodiscard]] std::pair<HitData, numberType>
+    sample(Sampler& sampler) const {
+        if (table.empty()) return { HitData{}, 0.0 };
+        int index = table.sample(sampler.get1D());
+        const auto& emitter = emitters[index];
+        auto [pos, pdf] = emitter.object->samplePrimitive(emitter.primId, sampler);
+        pos.radiance = emitter.object->getEmission();
+        // 图元内部的面积pdf * 选中该图元的概率
+        return { pos, pdf * table.pmf(index) };
+    }
+
+    // 光源上任意一点被采到的面积pdf，按面积构建分布时处处为 1 / 发光总面积
+    [[nodiscard]] numberType
+    areaPdf() const { return table.empty() ? 0.0 : 1.0 / table.sum(); }
+
+    // 第index个发光图元被选中的概率
+    [[nodiscard]] numberType
+    pmf(int index) const { return table.pmf(index); }
+
+    // 发光图元的个数
+    [[nodiscard]] int
+    size() const noexcept { return table.size(); }
+
+    // 发光总面积
+    [[nodiscard]] numberType
+    area() const noexcept { return table.sum(); }
+};
+
+}
+
+#endif //ANYA_RENDERER_LIGHT_DISTRIBUTION_HPP
@@ -0,0 +1,167 @@
+#ifndef ANYA_RENDERER_TRIANGLE_INTERSECTOR_HPP
+#define ANYA_RENDERER_TRIANGLE_INTERSECTOR_HPP
+
+#include "component/ray_packet.hpp"
+#include "tool/stats.hpp"
+#include <cmath>
+#include <bit>
+
+namespace anya {
+
+// 三角形求交算法
+enum class TriangleTest {
+    PRECOMPUTED,  // 预计算边向量的MT算法，速度快，相邻三角形的公共边上可能漏掉交点
+    WATERTIGHT    // Woop等人的水密算法，直接使用原始顶点，公共边上不会漏掉交点
+};
+
+// 加载网格时预计算的三角形求交数据: 一个顶点与两条边
+struct TriangleRecord {
+    Vector3 v0{};
+    Vector3 e1{};
+    Vector3 e2{};
+
+    TriangleRecord() = default;
+
+    TriangleRecord(const Vector3& p0, const Vector3& p1, const Vector3& p2)
+        : v0(p0), e1(p1 - p0), e2(p2 - p0)
+    {}
+};
+
+// 一条光线与三角形的求交器，在遍历开始前构造一次，保存与三角形无关的逐光线数据
+// 两种算法都只接受正面(光线方向与 e1 x e2 相反)的交点，返回的 u, v 为第二、三个顶点的重心坐标
+// 只计算距离与重心坐标，法线和插值属性由调用者在确定最近交点后再计算
+class TriangleIntersector {
+private:
+    const Ray& ray;
+    // 水密算法的逐光线数据: 方向分量绝对值最大的轴为kz，剪切变换把光线方向变为 +z
+    int kx = 0, ky = 1, kz = 2;
+    numberType Sx = 0.0, Sy = 0.0, Sz = 1.0;
+
+public:
+    explicit TriangleIntersector(const Ray& r): ray(r) {
+        const Vector3& dir = ray.dir;
+        numberType ax = std::fabs(dir.x()), ay = std::fabs(dir.y()), az = std::fabs(dir.z());
+        kz = ax > ay ? (ax > az ? 0 : 2) : (ay > az ? 1 : 2);
+        kx = (kz + 1) % 3;
+        ky = (kx + 1) % 3;
+        // 保持三角形的环绕方向不变
+        if (dir[kz] < 0.0) std::swap(kx, ky);
+        Sx = dir[kx] / dir[kz];
+        Sy = dir[ky] / dir[kz];
+        Sz = 1.0 / dir[kz];
+    }
+
+public:
+    // 使用预计算数据的MT算法，尽早拒绝，det不大于0时为背面或与光线平行
+    [[nodiscard]] bool
+    intersect(const TriangleRecord& tri, numberType& tNear, numberType& u, numberType& v) const {
+        RenderStats::count(&RenderStats::triangleTests);
+        Vector3 S1 = ray.dir.cross(tri.e2);
+        numberType det = S1.dot(tri.e1);
+        if (!(det > 0.0)) return false;
+
+        numberType invDet = 1.0 / det;
+        Vector3 S = ray.pos - tri.v0;
+        u = S1.dot(S) * invDet;
+        if (u < 0.0 || u > 1.0) return false;
+        Vector3 S2 = S.cross(tri.e1);
+        v = S2.dot(ray.dir) * invDet;
+        if (v < 0.0 || u + v > 1.0) return false;
+        tNear = S2.dot(tri.e2) * invDet;
+        return tNear > 0.0;
+    }
+
+    // 水密算法，见 Woop, Benthin, Wald, "Watertight Ray/Triangle Intersection"
+    // 顶点先平移到光线起点并剪切到光线空间，再用二维边函数判断，共享边的两侧得到完全一致的边函数值
+    [[nodiscard]] bool
+    intersect(const Vector3& p0, const Vector3& p1, const Vector3& p2, numberType& tNear, numberType& u, numberType& v) const {
+        RenderStats::count(&RenderStats::triangleTests);
+        Vector3 A = p0 - ray.pos;
+        Vector3 B = p1 - ray.pos;
+        Vector3 C = p2 - ray.pos;
+        numberType Ax = A[kx] - Sx * A[kz], Ay = A[ky] - Sy * A[kz];
+        numberType Bx = B[kx] - Sx * B[kz], By = B[ky] - Sy * B[kz];
+        numberType Cx = C[kx] - Sx * C[kz], Cy = C[ky] - Sy * C[kz];
+
+        // 三条边函数，正面的交点三者均不为负
+        numberType U = Cx * By - Cy * Bx;
+        numberType V = Ax * Cy - Ay * Cx;
+        numberType W = Bx * Ay - By * Ax;
+        if (U < 0.0 || V < 0.0 || W < 0.0) return false;
+        numberType det = U + V + W;
+        if (det == 0.0) return false;
+
+        numberType T = U * Sz * A[kz] + V * Sz * B[kz] + W * Sz * C[kz];
+        if (T <= 0.0) return false;
+        numberType invDet = 1.0 / det;
+        tNear = T * invDet;
+        u = V * invDet;
+        v = W * invDet;
+        return true;
+    }
+};
+
+// 光线包与三角形的求交，与TriangleIntersector的PRECOMPUTED算法逐运算一致，4条光线的结果与逐条求交逐位相同
+class PacketTriangleIntersector {
+private:
+    const RayPacket& packet;
+    Double4 ox, oy, oz;     // 光线起点
+    Double4 dx, dy, dz;     // 光线方向
+
+public:
+    explicit PacketTriangleIntersector(const RayPacket& p): packet(p) {
+        ox = Double4::load(packet.origin[0]);
+        oy = Double4::load(packet.origin[1]);
+        oz = Double4::load(packet.origin[2]);
+        dx = Double4::load(packet.dir[0]);
+        dy = Double4::load(packet.dir[1]);
+        dz = Double4::load(packet.dir[2]);
+    }
+
+public:
+    // 对mask中的光线做MT求交，返回交点在 (0, packet.tMax) 内的通道掩码，tNear, u, v按通道写出
+    [[nodiscard]] int
+    intersect(const TriangleRecord& tri, int mask, numberType* tNear, numberType* u, numberType* v) const {
+        RenderStats::count(&RenderStats::triangleTests, std::popcount(static_cast<unsigned>(mask)));
+        Double4 e1x(tri.e1.x()), e1y(tri.e1.y()), e1z(tri.e1.z());
+        Double4 e2x(tri.e2.x()), e2y(tri.e2.y()), e2z(tri.e2.z());
+        Double4 zero(0.0), one(1.0);
+
+        // S1 = dir x e2, det = S1 . e1
+        Double4 s1x = dy * e2z - e2y * dz;
+        Double4 s1y = e2x * dz - dx * e2z;
+        Double4 s1z = dx * e2y - e2x * dy;
+        Double4 det = s1x * e1x + s1y * e1y + s1z * e1z;
+        mask &= det > zero;
+        if (mask == 0) return 0;
+
+        Double4 invDet = one / det;
+        Double4 sx = ox - Double4(tri.v0.x());
+        Double4 sy = oy - Double4(tri.v0.y());
+        Double4 sz = oz - Double4(tri.v0.z());
+        Double4 U = (s1x * sx + s1y * sy + s1z * sz) * invDet;
+        mask &= (U >= zero) & (U <= one);
+        if (mask == 0) return 0;
+
+        // S2 = S x e1
+        Double4 s2x = sy * e1z - e1y * sz;
+        Double4 s2y = e1x * sz - sx * e1z;
+        Double4 s2z = sx * e1y - e1x * sy;
+        Double4 V = (s2x * dx + s2y * dy + s2z * dz) * invDet;
+        mask &= (V >= zero) & (U + V <= one);
+        if (mask == 0) return 0;
+
+        Double4 T = (s2x * e2x + s2y * e2y + s2z * e2z) * invDet;
+        mask &= (T > zero) & (T < Double4::load(packet.tMax));
+        if (mask == 0) return 0;
+
+        T.store(tNear);
+        U.store(u);
+        V.store(v);
+        return mask;
+    }
+};
+
+}
+
+#endif //ANYA_RENDERER_TRIANGLE_INTERSECTOR_HPP
@@ -8,8 +8,8 @@
 #include "tool/matrix.hpp"
 #include "tool/utils.hpp"
 #include "component/ray.hpp"
+#include "tool/sampler.hpp"
 #include <cmath>
-#include <GLFW/glfw3.h>
 
 namespace anya{
 
@@ -23,12 +23,12 @@ namespace anya{
 
 class Camera {
 private:
-    Vector3 eye_pos;                     // 摄像机位置
-    Vector3 obj_pos;                     // 物体位置
-    GLdouble view_width, view_height;    // 视窗大小
-    GLdouble fovY;                       // 视野角度
-    GLdouble zNear = -0.1, zFar = -50.0; // 视锥近远平面距离
-    GLdouble aspect_ratio;               // 宽高比
+    Vector3 eye_pos;                       // 摄像机位置
+    Vector3 obj_pos;                       // 物体位置
+    numberType view_width, view_height;    // 视窗大小
+    numberType fovY;                       // 视野角度
+    numberType zNear = -0.1, zFar = -50.0; // 视锥近远平面距离
+    numberType aspect_ratio;               // 宽高比
 
     // 摄像机坐标系:
     Vector3 w;     // 观察方向
@@ -41,9 +41,9 @@ public:
 public:
     Camera(const Vector3& eye_pos,    // 摄像机位置
            const Vector3& obj_pos,    // 物体的位置
-           GLdouble view_width,       // 视窗宽度
-           GLdouble view_height,      // 视窗高度
-           GLdouble angle             // 视角——角度制，需要转换
+           numberType view_width,     // 视窗宽度
+           numberType view_height,    // 视窗高度
+           numberType angle           // 视角——角度制，需要转换
            ): eye_pos(eye_pos), obj_pos(obj_pos), view_width(view_width),
               view_height(view_height), fovY(MathUtils::angle2rad(angle)) {
         // 宽高比
@@ -56,13 +56,13 @@ public:
 
 public:
     // 获取zNear
-    [[nodiscard]] GLdouble
+    [[nodiscard]] numberType
     getZNear() const {
         return zNear;
     }
 
     // 获取长宽
-    [[nodiscard]] std::pair<GLdouble, GLdouble>
+    [[nodiscard]] std::pair<numberType, numberType>
     getWH() const {
         return { view_width, view_height };
     }
@@ -119,11 +119,11 @@ public:
 
     // 投影变换
     [[nodiscard]] Matrix44 getProjectionMat() const {
-        GLdouble n = zNear, f = zFar;
-        GLdouble t = std::fabs(n) * std::tan(fovY / 2);
-        GLdouble b = -t;
-        GLdouble r = aspect_ratio * t;
-        GLdouble l = -r;
+        numberType n = zNear, f = zFar;
+        numberType t = std::fabs(n) * std::tan(fovY / 2);
+        numberType b = -t;
+        numberType r = aspect_ratio * t;
+        numberType l = -r;
 
         // 这里有修正符号 -2 * f * n / (f - n)，没有这个符号就是深度就是反的，主要原因是我们采用的是右手系，而opengl是左手系
         Matrix44 Mprojection{};
@@ -145,16 +145,14 @@ public:
     }
 
 public:
-    // 发出光线，用于光线追踪
+    // 发出光线，用于光线追踪，像素内的抖动由采样器提供
     [[nodiscard]] Ray
-    biuRay(int i, int j) const {
-        Ray ray{};
+    biuRay(int i, int j, Sampler& sampler) const {
         numberType scale = std::tan(fovY / 2);
-        numberType x = (2 * (i + MathUtils::getRandNum()) / view_width - 1) * scale * aspect_ratio;
-        numberType y = (1 - 2 * (j + MathUtils::getRandNum()) / view_height) * scale;
-        ray.dir = Vector3{ x, y, 1 }.normalize();
-        ray.pos = eye_pos;
-        return ray;
+        Vector2 jitter = sampler.get2D();
+        numberType x = (2 * (i + jitter.x()) / view_width - 1) * scale * aspect_ratio;
+        numberType y = (1 - 2 * (j + jitter.y()) / view_height) * scale;
+        return { eye_pos, Vector3{ x, y, 1 }.normalize() };
     }
 
 };
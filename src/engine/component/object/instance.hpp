@@ -0,0 +1,195 @@
+#ifndef ANYA_RENDERER_INSTANCE_HPP
+#define ANYA_RENDERER_INSTANCE_HPP
+
+#include "interface/object.hpp"
+#include "tool/matrix.hpp"
+
+namespace anya {
+
+// 实例: 两层加速结构中的顶层图元
+// 同一份网格资源(底层BVH)只加载和构建一次，由多个实例共享，每个实例只保存自己的变换矩阵与材质
+// 求交时将光线变换到物体空间，方向不做归一化，因此物体空间与世界空间的tNear一致
+class Instance: public Object {
+private:
+    std::shared_ptr<Object> prototype;              // 共享的原型(底层加速结构)
+    Matrix44 objectToWorld = Matrix44::Identity();  // 物体空间到世界空间
+    Matrix44 worldToObject = Matrix44::Identity();  // 世界空间到物体空间
+    Matrix44 normalMat = Matrix44::Identity();      // 法线变换矩阵，即objectToWorld的逆转置
+    bool identity = true;                           // 单位变换时跳过光线变换
+    numberType jacobian = 1.0;                      // |det(M)|，M为objectToWorld的线性部分
+    numberType area = 0.0;                          // 世界空间的总面积
+
+public:
+    Instance(std::shared_ptr<Object> proto, const std::shared_ptr<Material>& m, const Matrix44& transform = Matrix44::Identity())
+        : prototype(std::move(proto)), objectToWorld(transform) {
+        this->material = m;
+        for (int i = 0; i < 4 && identity; ++i) {
+            for (int j = 0; j < 4 && identity; ++j) {
+                identity = objectToWorld(i, j) == (i == j ? 1.0 : 0.0);
+            }
+        }
+        if (!identity) {
+            worldToObject = objectToWorld.inverse();
+            normalMat = worldToObject.transpose();
+            jacobian = std::fabs(objectToWorld.to<3, 3>().det());
+        }
+        this->box = computeBoundingBox();
+        for (int i = 0; i < primitiveCount(); ++i) {
+            area += primitiveArea(i);
+        }
+    }
+
+public:
+    // 在原型中求交，命中时把自己记录到相交路径上，重建相交信息时再逐层变换回来
+    bool
+    intersect(const Ray& ray, HitRecord& rec) override {
+        HitRecord local{};
+        local.t = rec.t;
+        if (!prototype->intersect(toObject(ray), local)) return false;
+        if (local.instanceDepth >= HitRecord::maxInstanceDepth) {
+            throw std::runtime_error("Instance::intersect: instances are nested too deeply");
+        }
+        local.instances[local.instanceDepth++] = this;
+        rec = local;
+        return true;
+    }
+
+    [[nodiscard]] HitData
+    interaction(const Ray& ray, const HitRecord& rec) override {
+        // 去掉最外层的自己，交给下一层重建物体空间中的相交信息
+        HitRecord inner = rec;
+        --inner.instanceDepth;
+        Ray local = toObject(ray);
+        HitData hitData = inner.resolve(local);
+        if (!identity) {
+            hitData.hitPoint = ray.at(rec.t);
+            hitData.normal = (normalMat * hitData.normal.to4(0.0)).to<3>().normalize();
+        }
+        // 命中的物体替换为实例本身，着色时使用实例的材质
+        hitData.hitObject = shared_from_this();
+        return hitData;
+    }
+
+    [[nodiscard]] bool
+    occludes(const Ray& ray, numberType tMax) override {
+        return prototype->occludes(toObject(ray), tMax);
+    }
+
+    // 把整个光线包变换到物体空间后交给原型，原型为网格时在底层BVH中继续按包遍历
+    void
+    intersect(RayPacket& packet, HitRecord* recs, int mask) override {
+        RayPacket local = toObject(packet);
+        HitRecord locals[RayPacket::width]{};
+        prototype->intersect(local, locals, mask);
+        for (int lane = 0; lane < RayPacket::width; ++lane) {
+            if (!(mask >> lane & 1) || !(local.tMax[lane] < packet.tMax[lane])) continue;
+            auto& rec = locals[lane];
+            if (rec.instanceDepth >= HitRecord::maxInstanceDepth) {
+                throw std::runtime_error("Instance::intersect: instances are nested too deeply");
+            }
+            rec.instances[rec.instanceDepth++] = this;
+            recs[lane] = rec;
+            packet.tMax[lane] = rec.t;
+        }
+    }
+
+    [[nodiscard]] int
+    occludes(const RayPacket& packet, int mask) override {
+        return prototype->occludes(toObject(packet), mask);
+    }
+
+    [[nodiscard]] AABB
+    getBoundingBox() const override {
+        return box;
+    }
+
+    numberType
+    getArea() const override {
+        return area;
+    }
+
+    std::pair<HitData, numberType>
+    sample(Sampler& sampler) const override {
+        auto [pos, pdf] = prototype->sample(sampler);
+        return toWorld(pos, pdf);
+    }
+
+    [[nodiscard]] int
+    primitiveCount() const override {
+        return prototype->primitiveCount();
+    }
+
+    [[nodiscard]] numberType
+    primitiveArea(int id) const override {
+        return identity ? prototype->primitiveArea(id) : prototype->transformedArea(id, objectToWorld);
+    }
+
+    // 嵌套实例: 先经过自己的变换再经过外层的变换
+    [[nodiscard]] numberType
+    transformedArea(int id, const Matrix44& transform) const override {
+        return prototype->transformedArea(id, transform * objectToWorld);
+    }
+
+    std::pair<HitData, numberType>
+    samplePrimitive(int id, Sampler& sampler) const override {
+        auto [pos, pdf] = prototype->samplePrimitive(id, sampler);
+        return toWorld(pos, pdf);
+    }
+
+private:
+    // 将世界空间的光线变换到物体空间
+    [[nodiscard]] Ray
+    toObject(const Ray& ray) const {
+        if (identity) return ray;
+        return { (worldToObject * ray.pos.to4()).to<3>(), (worldToObject * ray.dir.to4(0.0)).to<3>(), ray.tMin, ray.tMax };
+    }
+
+    // 将世界空间的光线包逐条变换到物体空间
+    [[nodiscard]] RayPacket
+    toObject(const RayPacket& packet) const {
+        if (identity) return packet;
+        Ray rays[RayPacket::width];
+        for (int lane = 0; lane < RayPacket::width; ++lane) {
+            rays[lane] = toObject(packet.ray(lane));
+        }
+        RayPacket ret(rays, packet.tMax, RayPacket::width);
+        ret.active = packet.active;
+        return ret;
+    }
+
+    // 把原型上的采样点变换到世界空间，辐射率使用实例的材质
+    // 面元经线性变换M后 dA' = |det M| * |M^-T n| * dA，面积pdf按该点处的面积比缩放，非均匀缩放时同样精确
+    [[nodiscard]] std::pair<HitData, numberType>
+    toWorld(HitData pos, numberType pdf) const {
+        if (!identity) {
+            pos.hitPoint = (objectToWorld * pos.hitPoint.to4()).to<3>();
+            Vector3 normal = (normalMat * pos.normal.to4(0.0)).to<3>();
+            numberType length = normal.norm2();
+            pos.normal = normal / length;
+            pdf /= jacobian * length;
+        }
+        pos.radiance = this->material->emission;
+        return { pos, pdf };
+    }
+
+    // 变换原型包围盒的8个顶点得到世界空间的包围盒
+    [[nodiscard]] AABB
+    computeBoundingBox() const {
+        AABB local = prototype->getBoundingBox();
+        if (identity) return local;
+        std::array<Vector3, 8> corners{};
+        for (int i = 0; i < 8; ++i) {
+            corners[i] = { i & 1 ? local.pMax.x() : local.pMin.x(),
+                           i & 2 ? local.pMax.y() : local.pMin.y(),
+                           i & 4 ? local.pMax.z() : local.pMin.z() };
+        }
+        objectToWorld.transformPoints(corners.data(), corners.data(), corners.size());
+        AABB ret{};
+        for (const auto& corner : corners) ret.expand(corner);
+        return ret;
+    }
+};
+
+}
+
+#endif //ANYA_RENDERER_INSTANCE_HPP
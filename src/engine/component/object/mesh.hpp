@@ -7,34 +7,66 @@
 
 #include "interface/object.hpp"
 #include "accelerator/BVH.hpp"
+#include "accelerator/triangle_intersector.hpp"
+#include "tool/profiler.hpp"
+#include <array>
+#include <cstdint>
+#include <tuple>
 
 namespace anya {
 
+// 索引三角形网格
+// 顶点、法线、纹理坐标各自存放在共享数组中，每个三角形只记录三个顶点下标，
+// BVH只在三角形包围盒上构建，叶子中的三角形由网格自己求交，不再为每个面创建Triangle对象
 class Mesh: public Object {
 private:
+    using Face = std::array<std::uint32_t, 3>;
+
+    // 共享的顶点属性，以单精度存放以减少内存占用与缓存压力，读取时再转换为双精度参与计算
+    std::vector<Vector3fA> positions;    // 顶点坐标，填充并对齐到16字节
+    std::vector<Vector3f> normals;       // 顶点法线
+    std::vector<Vector2f> uvs;           // 纹理坐标
+    // 每个三角形的下标记录，按BVH叶子顺序存放
+    std::vector<Face> faces;             // 顶点下标
+    std::vector<Face> normalFaces;       // 法线下标，obj中没有法线时为空
+    std::vector<Face> uvFaces;           // 纹理坐标下标，obj中没有纹理坐标时为空
+    std::vector<TriangleRecord> records; // 预计算的求交数据，只在使用PRECOMPUTED算法时构建
+    std::vector<numberType> areaPrefix;  // 三角形面积的前缀和，用于按面积采样
     // BVH树
     std::shared_ptr<BVH> bvh = nullptr;
+    // 三角形求交算法
+    TriangleTest test = TriangleTest::PRECOMPUTED;
     // 网格的面积
     numberType area = 0.0;
 
 public:
-    explicit Mesh(const std::string& meshPath, const std::shared_ptr<Material>& m) {
+    explicit Mesh(const std::string& meshPath, const std::shared_ptr<Material>& m, const BVHConfig& config = {},
+                  TriangleTest triangleTest = TriangleTest::PRECOMPUTED): test(triangleTest) {
         this->material = m;
         loadFromDisk(meshPath);
-        bvh = std::make_shared<BVH>(childs);
+        buildBVH(config);
+    }
+
+    // 底层BVH的构建耗时(秒)
+    [[nodiscard]] double
+    bvhBuildSeconds() const {
+        return bvh ? bvh->buildSeconds : 0.0;
     }
 
     void
     loadFromDisk(const std::string& meshPath) {
+        ProfileScope profile("Mesh::loadFromDisk", "load", meshPath);
         std::ifstream ifs(meshPath);
         if (!ifs.is_open()) {
             std::cerr << "can not find the " + meshPath << std::endl;
             exit(-1);
         }
 
-        std::vector<Vector3> vertexes{};      // 从obj读入的所有顶点集合
         Vector3 vertex{};                     // 顶点
-        this->area = 0.0;                     // 重新计算面积
+        Vector3 normal{};                     // 法线
+        Vector2 uv{};                         // 纹理坐标
+        bool hasNormals = true;               // 所有面都带有法线下标
+        bool hasUVs = true;                   // 所有面都带有纹理坐标下标
 
         // 每次读入一行，并判断该行的类型
         std::string line, type;
@@ -43,43 +75,151 @@ public:
             iss >> type;
             if (type == "v") {
                 iss >> vertex.x() >> vertex.y() >> vertex.z();
-                vertexes.push_back(vertex);
-                this->box = AABB::merge(this->box, vertex);
+                positions.push_back(Vector3f(vertex));
+                this->box = AABB::merge(this->box, Vector3(positions.back()));
+            }
+            else if (type == "vn") {
+                iss >> normal.x() >> normal.y() >> normal.z();
+                normals.push_back(Vector3f(normal));
+            }
+            else if (type == "vt") {
+                iss >> uv.x() >> uv.y();
+                uvs.push_back(Vector2f(uv));
             }
             else if (type == "f") {
-                auto triangle = std::make_shared<Triangle>();
-                for (int i = 0; i < 3; ++i) {
-                    int index = 0;
-                    iss >> index;
-                    triangle->setVertex(i, vertexes[index - 1].to4());
+                // f v1[/vt1][/vn1] v2... 多边形按扇形拆分为三角形
+                std::vector<std::array<int, 3>> corners;
+                std::string token;
+                while (iss >> token) {
+                    corners.push_back(parseCorner(token));
+                }
+                for (std::size_t k = 1; k + 1 < corners.size(); ++k) {
+                    const auto& c0 = corners[0];
+                    const auto& c1 = corners[k];
+                    const auto& c2 = corners[k + 1];
+                    faces.push_back(toFace(c0[0], c1[0], c2[0], positions.size()));
+                    hasUVs = hasUVs && c0[1] && c1[1] && c2[1];
+                    hasNormals = hasNormals && c0[2] && c1[2] && c2[2];
+                    if (hasUVs) uvFaces.push_back(toFace(c0[1], c1[1], c2[1], uvs.size()));
+                    if (hasNormals) normalFaces.push_back(toFace(c0[2], c1[2], c2[2], normals.size()));
                 }
-                triangle->material = this->material;
-                childs.push_back(triangle);
-                area += triangle->getArea();
             }
         }
         ifs.close();
-        std::cout << "vertex: " << vertexes.size() << ", face: " << childs.size() << std::endl << std::endl;
+        if (!hasNormals) normalFaces.clear();
+        if (!hasUVs) uvFaces.clear();
+        std::cout << "vertex: " << positions.size() << ", face: " << faces.size() << std::endl << std::endl;
     }
 
 public:
-#pragma region whitted_style api
-    [[nodiscard]] Vector3
-    evalDiffuseColor(const Vector2& st) const override {
-        std::cerr << "Should not get here on Mesh::evalDiffuseColor" << std::endl;
-        return {};
+    bool
+    intersect(const Ray& ray, HitRecord& rec) override {
+        if (!bvh) return false;
+        TriangleIntersector intersector(ray);
+        bool hit = bvh->intersect(ray, rec.t, [&](int first, int count, numberType& tMax) {
+            bool found = false;
+            for (int i = first; i < first + count; ++i) {
+                numberType t, u, v;
+                if (intersectFace(intersector, i, t, u, v) && t < tMax) {
+                    tMax = t;
+                    rec.u = u;
+                    rec.v = v;
+                    rec.primId = i;
+                    found = true;
+                }
+            }
+            return found;
+        });
+        if (hit) {
+            rec.object = this;
+            rec.instanceDepth = 0;
+        }
+        return hit;
     }
 
-#pragma endregion
-
-public:
-    [[nodiscard]] std::optional<HitData>
-    getIntersect(const Ray& ray) override {
-        std::optional<HitData> hitData{};
-        if (bvh) hitData = bvh->intersect(ray);
+    // 只为最近的交点构造相交信息
+    [[nodiscard]] HitData
+    interaction(const Ray& ray, const HitRecord& rec) override {
+        int face = rec.primId;
+        auto [p0, p1, p2] = vertexesOf(face);
+        numberType alpha = 1 - rec.u - rec.v;
+        HitData hitData{};
+        hitData.tNear = rec.t;
+        hitData.hitObject = shared_from_this();
+        hitData.hitPoint = ray.at(rec.t);
+        hitData.uv = Vector2{ rec.u, rec.v };
+        if (normalFaces.empty()) {
+            hitData.normal = (p1 - p0).cross(p2 - p0).normalize();
+        }
+        else {
+            const auto& n = normalFaces[face];
+            hitData.normal = MathUtils::interpolate(alpha, rec.u, rec.v, Vector3(normals[n[0]]), Vector3(normals[n[1]]), Vector3(normals[n[2]])).normalize();
+        }
+        if (!uvFaces.empty()) {
+            const auto& t = uvFaces[face];
+            hitData.st = MathUtils::interpolate(alpha, rec.u, rec.v, Vector2(uvs[t[0]]), Vector2(uvs[t[1]]), Vector2(uvs[t[2]]));
+        }
         return hitData;
     }
 
+    [[nodiscard]] bool
+    occludes(const Ray& ray, numberType tMax) override {
+        if (!bvh) return false;
+        TriangleIntersector intersector(ray);
+        return bvh->occluded(ray, tMax, [&](int first, int count) {
+            for (int i = first; i < first + count; ++i) {
+                numberType t, u, v;
+                if (intersectFace(intersector, i, t, u, v) && t < tMax) return true;
+            }
+            return false;
+        });
+    }
+
+    // 按包遍历网格的BVH，PRECOMPUTED算法下叶子中的三角形与整个光线包一次求交，水密算法退回逐条光线
+    void
+    intersect(RayPacket& packet, HitRecord* recs, int mask) override {
+        if (!bvh) return;
+        if (test != TriangleTest::PRECOMPUTED) {
+            Object::intersect(packet, recs, mask);
+            return;
+        }
+        PacketTriangleIntersector intersector(packet);
+        alignas(32) numberType t[RayPacket::width], u[RayPacket::width], v[RayPacket::width];
+        bvh->intersect(packet, mask, [&](int first, int count, int laneMask) {
+            for (int i = first; i < first + count; ++i) {
+                int hit = intersector.intersect(records[i], laneMask, t, u, v);
+                for (int lane = 0; hit != 0; ++lane, hit >>= 1) {
+                    if (!(hit & 1)) continue;
+                    packet.tMax[lane] = t[lane];
+                    auto& rec = recs[lane];
+                    rec.t = t[lane];
+                    rec.u = u[lane];
+                    rec.v = v[lane];
+                    rec.primId = i;
+                    rec.object = this;
+                    rec.instanceDepth = 0;
+                }
+            }
+        });
+    }
+
+    [[nodiscard]] int
+    occludes(const RayPacket& packet, int mask) override {
+        if (!bvh) return 0;
+        if (test != TriangleTest::PRECOMPUTED) return Object::occludes(packet, mask);
+        PacketTriangleIntersector intersector(packet);
+        alignas(32) numberType t[RayPacket::width], u[RayPacket::width], v[RayPacket::width];
+        return bvh->occluded(packet, mask, [&](int first, int count, int laneMask) {
+            int ret = 0;
+            for (int i = first; i < first + count && laneMask != 0; ++i) {
+                int hit = intersector.intersect(records[i], laneMask, t, u, v);
+                ret |= hit;
+                laneMask &= ~hit;
+            }
+            return ret;
+        });
+    }
+
     [[nodiscard]] AABB
     getBoundingBox() const override {
         return box;
@@ -90,12 +230,135 @@ public:
         return area;
     }
 
+    // 先按面积选中一个三角形，再在三角形内均匀采样
     std::pair<HitData, numberType>
-    sample() const override {
-        auto [pos, pdf] = bvh->sample();
-        pos.radiance = this->material->emission;
+    sample(Sampler& sampler) const override {
+        auto p = sampler.get1D() * area;
+        auto it = std::upper_bound(areaPrefix.begin(), areaPrefix.end(), p);
+        auto index = static_cast<int>(std::min<std::size_t>(it - areaPrefix.begin(), faces.size() - 1));
+        auto [pos, pdf] = samplePrimitive(index, sampler);
+        // 三角形内部的面积pdf * 选中该三角形的概率
+        pdf *= primitiveArea(index) / area;
         return { pos, pdf };
     }
+
+    [[nodiscard]] int
+    primitiveCount() const override {
+        return static_cast<int>(faces.size());
+    }
+
+    [[nodiscard]] numberType
+    primitiveArea(int id) const override {
+        auto [v0, v1, v2] = vertexesOf(id);
+        return (v1 - v0).cross(v2 - v0).norm2() * 0.5;
+    }
+
+    // 仿射变换保持三角形为平面，直接用变换后的边求面积，非均匀缩放时同样精确
+    [[nodiscard]] numberType
+    transformedArea(int id, const Matrix44& transform) const override {
+        auto [v0, v1, v2] = vertexesOf(id);
+        Vector3 E1 = (transform * (v1 - v0).to4(0.0)).to<3>();
+        Vector3 E2 = (transform * (v2 - v0).to4(0.0)).to<3>();
+        return E1.cross(E2).norm2() * 0.5;
+    }
+
+    std::pair<HitData, numberType>
+    samplePrimitive(int id, Sampler& sampler) const override {
+        auto [v0, v1, v2] = vertexesOf(id);
+        Vector3 E1 = v1 - v0;
+        Vector3 E2 = v2 - v0;
+        auto x = std::sqrt(sampler.get1D());
+        auto y = sampler.get1D();
+        HitData pos{};
+        pos.hitPoint = v0 * (1.0 - x) + v1 * (x * (1.0 - y)) + v2 * (x * y);
+        pos.normal = E1.cross(E2).normalize();
+        pos.radiance = this->material->emission;
+        return { pos, 1.0 / primitiveArea(id) };
+    }
+
+private:
+    // 在三角形包围盒上构建BVH，并把三角形记录重排为叶子顺序，叶子直接引用连续的三角形区间
+    void
+    buildBVH(const BVHConfig& config) {
+        std::vector<AABB> bounds(faces.size());
+        for (std::size_t i = 0; i < faces.size(); ++i) {
+            auto [v0, v1, v2] = vertexesOf(static_cast<int>(i));
+            bounds[i] = AABB::merge(AABB(v0, v1), v2);
+        }
+        std::vector<int> order;
+        bvh = std::make_shared<BVH>(bounds, order, config);
+        reorder(faces, order);
+        reorder(normalFaces, order);
+        reorder(uvFaces, order);
+        if (test == TriangleTest::PRECOMPUTED) {
+            records.reserve(faces.size());
+            for (std::size_t i = 0; i < faces.size(); ++i) {
+                auto [v0, v1, v2] = vertexesOf(static_cast<int>(i));
+                records.emplace_back(v0, v1, v2);
+            }
+        }
+
+        this->area = 0.0;
+        areaPrefix.clear();
+        areaPrefix.reserve(faces.size());
+        for (std::size_t i = 0; i < faces.size(); ++i) {
+            auto [v0, v1, v2] = vertexesOf(static_cast<int>(i));
+            area += (v1 - v0).cross(v2 - v0).norm2() * 0.5;
+            areaPrefix.push_back(area);
+        }
+    }
+
+    // 求光线与第i个三角形的交点，背面不相交
+    [[nodiscard]] bool
+    intersectFace(const TriangleIntersector& intersector, int i, numberType& tNear, numberType& u, numberType& v) const {
+        if (test == TriangleTest::PRECOMPUTED) {
+            return intersector.intersect(records[i], tNear, u, v);
+        }
+        auto [v0, v1, v2] = vertexesOf(i);
+        return intersector.intersect(v0, v1, v2, tNear, u, v);
+    }
+
+    // 第i个三角形的三个顶点，转换为双精度
+    [[nodiscard]] std::tuple<Vector3, Vector3, Vector3>
+    vertexesOf(int i) const {
+        const auto& face = faces[i];
+        return { Vector3(positions[face[0]]), Vector3(positions[face[1]]), Vector3(positions[face[2]]) };
+    }
+
+    // 解析面中的一个顶点 "v", "v/vt", "v//vn" 或 "v/vt/vn"，缺省的下标记为0
+    static std::array<int, 3>
+    parseCorner(const std::string& token) {
+        std::array<int, 3> ret{};
+        std::size_t begin = 0;
+        for (int k = 0; k < 3 && begin <= token.size(); ++k) {
+            std::size_t end = token.find('/', begin);
+            if (end == std::string::npos) end = token.size();
+            if (end > begin) ret[k] = std::stoi(token.substr(begin, end - begin));
+            begin = end + 1;
+        }
+        return ret;
+    }
+
+    // obj的下标从1开始，负数表示从末尾倒数
+    static Face
+    toFace(int a, int b, int c, std::size_t size) {
+        auto index = [size](int i) {
+            return static_cast<std::uint32_t>(i > 0 ? i - 1 : static_cast<int>(size) + i);
+        };
+        return { index(a), index(b), index(c) };
+    }
+
+    template<class T>
+    static void
+    reorder(std::vector<T>& items, const std::vector<int>& order) {
+        if (items.empty()) return;
+        std::vector<T> ret;
+        ret.reserve(order.size());
+        for (int index : order) {
+            ret.push_back(items[index]);
+        }
+        items.swap(ret);
+    }
 };
 
 
@@ -6,6 +6,7 @@
 #define ANYA_RENDERER_SPHERE_HPP
 
 #include "interface/object.hpp"
+#include "tool/stats.hpp"
 
 namespace anya {
 
@@ -21,28 +22,47 @@ public:
 
 public:
     // 解析法求球面相交
-    [[nodiscard]] std::optional<HitData>
-    getIntersect(const Ray& ray) override {
-        std::optional<HitData> hitData{};
+    bool
+    intersect(const Ray& ray, HitRecord& rec) override {
+        RenderStats::count(&RenderStats::sphereTests);
         numberType a = ray.dir.dot(ray.dir);
         numberType b = 2 * ray.dir.dot(ray.pos - center);
         numberType c = (ray.pos - center).dot(ray.pos - center) - std::pow(radius, 2);
-        numberType tNear = 0.0;
         auto solve = MathUtils::solveQuadratic(a, b, c);
-        if (solve.has_value()) {
-            auto[t0, t1] = solve.value();
-            if (t0 < 0) t0 = t1;
-            if (t0 < 0) return hitData;
-            tNear = t0;
-            hitData.emplace();
-            hitData->hitPoint = ray.at(tNear);
-            hitData->normal = (hitData->hitPoint - center).normalize();
-            hitData->hitObject = shared_from_this();
-            hitData->tNear = tNear;
-        }
+        if (!solve.has_value()) return false;
+        auto [t0, t1] = solve.value();
+        if (t0 < 0) t0 = t1;
+        if (t0 < 0 || t0 >= rec.t) return false;
+        rec.t = t0;
+        rec.primId = 0;
+        rec.object = this;
+        rec.instanceDepth = 0;
+        return true;
+    }
+
+    [[nodiscard]] HitData
+    interaction(const Ray& ray, const HitRecord& rec) override {
+        HitData hitData{};
+        hitData.hitPoint = ray.at(rec.t);
+        hitData.normal = (hitData.hitPoint - center).normalize();
+        hitData.hitObject = shared_from_this();
+        hitData.tNear = rec.t;
         return hitData;
     }
 
+    [[nodiscard]] bool
+    occludes(const Ray& ray, numberType tMax) override {
+        RenderStats::count(&RenderStats::sphereTests);
+        numberType a = ray.dir.dot(ray.dir);
+        numberType b = 2 * ray.dir.dot(ray.pos - center);
+        numberType c = (ray.pos - center).dot(ray.pos - center) - std::pow(radius, 2);
+        auto solve = MathUtils::solveQuadratic(a, b, c);
+        if (!solve.has_value()) return false;
+        auto [t0, t1] = solve.value();
+        if (t0 < 0) t0 = t1;
+        return t0 >= 0 && t0 < tMax;
+    }
+
     [[nodiscard]] AABB
     getBoundingBox() const override {
         return AABB(Vector3{center.x() - radius, center.y() - radius, center.z() - radius},
@@ -55,7 +75,7 @@ public:
     }
 
     std::pair<HitData, numberType>
-    sample() const override {
+    sample(Sampler&) const override {
         throw std::runtime_error("The Sphere::sample() has not implemented!");
     }
 };
@@ -7,6 +7,7 @@
 
 #include "tool/matrix.hpp"
 #include "interface/object.hpp"
+#include "accelerator/triangle_intersector.hpp"
 #include <array>
 
 namespace anya {
@@ -30,49 +31,50 @@ public:
 #pragma endregion
 
 public:
-    // MT算法判断三角形与光线是否相交, 并返回相交信息
-    [[nodiscard]] std::optional<HitData>
-    getIntersect(const Ray& ray) override {
-        std::optional<HitData> hitData{};
-        const auto& v0 = a();
-        const auto& v1 = b();
-        const auto& v2 = c();
-        numberType u = 0.0;
-        numberType v = 0.0;
-        Vector3 E1 = (v1 - v0).to<3>();
-        Vector3 E2 = (v2 - v0).to<3>();
-        Vector3 S = ray.pos - v0.to<3>();
-        Vector3 S1 = ray.dir.cross(E2);
-        Vector3 S2 = S.cross(E1);
-        Vector3 normal = E1.cross(E2).normalize();
-        numberType det = S1.dot(E1);
-        numberType tNear = S2.dot(E2) / det;
-        u = S1.dot(S) / det;
-        v = S2.dot(ray.dir) / det;
-
-        if (std::fabs(det) < epsilon || ray.dir.dot(normal) > 0.0) return hitData;
-
-        if (u >= 0 && u <= 1 && v >= 0 && 1 - u - v >= 0 && tNear > 0.0) {
-            hitData.emplace();
-            hitData->tNear = tNear;
-            hitData->hitObject = shared_from_this();
-            hitData->hitPoint = ray.at(tNear);
-            hitData->normal = normal;
-            hitData->uv = Vector2{u, v};
-
-            // 此处的uv不是纹理坐标，而是三角形重心坐标的beta和gamma
-            const Vector2& st0 = stCoordinates[0];
-            const Vector2& st1 = stCoordinates[1];
-            const Vector2& st2 = stCoordinates[2];
-            auto alpha = 1 - u - v;
-            auto beta = u;
-            auto gamma = v;
-            auto st = MathUtils::interpolate(alpha, beta, gamma, st0, st1, st2);
-            hitData->st = st;
-        }
+    // MT算法判断三角形与光线是否相交
+    bool
+    intersect(const Ray& ray, HitRecord& rec) override {
+        numberType tNear, u, v;
+        if (!TriangleIntersector(ray).intersect(toRecord(), tNear, u, v) || tNear >= rec.t) return false;
+        rec.t = tNear;
+        rec.u = u;
+        rec.v = v;
+        rec.primId = 0;
+        rec.object = this;
+        rec.instanceDepth = 0;
+        return true;
+    }
+
+    // 法线与插值属性只为最近交点计算
+    [[nodiscard]] HitData
+    interaction(const Ray& ray, const HitRecord& rec) override {
+        TriangleRecord record = toRecord();
+        HitData hitData{};
+        hitData.tNear = rec.t;
+        hitData.hitObject = shared_from_this();
+        hitData.hitPoint = ray.at(rec.t);
+        hitData.normal = record.e1.cross(record.e2).normalize();
+        hitData.uv = Vector2{rec.u, rec.v};
+
+        // 此处的uv不是纹理坐标，而是三角形重心坐标的beta和gamma
+        const Vector2& st0 = stCoordinates[0];
+        const Vector2& st1 = stCoordinates[1];
+        const Vector2& st2 = stCoordinates[2];
+        auto alpha = 1 - rec.u - rec.v;
+        auto beta = rec.u;
+        auto gamma = rec.v;
+        auto st = MathUtils::interpolate(alpha, beta, gamma, st0, st1, st2);
+        hitData.st = st;
         return hitData;
     }
 
+    // 与intersect相同的MT测试，但不更新相交记录
+    [[nodiscard]] bool
+    occludes(const Ray& ray, numberType tMax) override {
+        numberType tNear, u, v;
+        return TriangleIntersector(ray).intersect(toRecord(), tNear, u, v) && tNear < tMax;
+    }
+
     [[nodiscard]] AABB
     getBoundingBox() const override {
         auto ret = AABB::merge(AABB(this->a().to<3>(), this->b().to<3>()), this->c().to<3>());
@@ -90,15 +92,22 @@ public:
         return area;
     }
 
+    [[nodiscard]] numberType
+    transformedArea(int, const Matrix44& transform) const override {
+        Vector3 E1 = (transform * (b() - a())).to<3>();
+        Vector3 E2 = (transform * (c() - a())).to<3>();
+        return E1.cross(E2).norm2() * 0.5;
+    }
+
     std::pair<HitData, numberType>
-    sample() const override {
+    sample(Sampler& sampler) const override {
         const auto& v0 = a().to<3>();
         const auto& v1 = b().to<3>();
         const auto& v2 = c().to<3>();
         Vector3 E1 = v1 - v0;
         Vector3 E2 = v2 - v0;
-        auto x = std::sqrt(MathUtils::getRandNum());
-        auto y = MathUtils::getRandNum();
+        auto x = std::sqrt(sampler.get1D());
+        auto y = sampler.get1D();
         HitData hitData{};
         hitData.hitPoint = v0 * (1.0 - x) + v1 * (x * (1.0 - y)) + v2 * (x * y);
         hitData.normal = E1.cross(E2).normalize();
@@ -112,6 +121,12 @@ public:
     [[nodiscard]] Vector4 b() const { return vertexes[1]; }
     [[nodiscard]] Vector4 c() const { return vertexes[2]; }
 
+    // 求交所需的顶点与边向量，顶点可能随时被修改，因此不做缓存
+    [[nodiscard]] TriangleRecord
+    toRecord() const {
+        return { a().to<3>(), b().to<3>(), c().to<3>() };
+    }
+
     // 设置顶点
     void
     setVertex(int index, const Vector4& vertex) {
@@ -6,16 +6,45 @@
 #define ANYA_RENDERER_RAY_HPP
 
 #include "tool/vec.hpp"
+#include <limits>
 
 namespace anya {
 
+// 光线，构造时预计算方向的倒数与各分量的符号，同一条光线在遍历中要与大量包围盒求交，不必每次都做除法
+// 修改方向需通过setDir，保证invDir与sign始终与dir一致
 class Ray {
 public:
     Vector3 pos{};
     Vector3 dir{};
+    Vector3 invDir{};       // 方向的倒数，分量为0时为±inf
+    int sign[3]{};          // invDir的分量为负时为1，用于选取包围盒的近面与远面
+    numberType tMin = 0.0;  // 包围盒测试的有效区间 [tMin, tMax]
+    numberType tMax = std::numeric_limits<numberType>::infinity();
+
+public:
+    Ray() = default;
+
+    Ray(const Vector3& p, const Vector3& d,
+        numberType t0 = 0.0, numberType t1 = std::numeric_limits<numberType>::infinity()): pos(p), tMin(t0), tMax(t1) {
+        setDir(d);
+    }
+
 public:
+    void
+    setDir(const Vector3& d) {
+        dir = d;
+        for (int i = 0; i < 3; ++i) {
+            invDir[i] = 1.0 / dir[i];
+            sign[i] = invDir[i] < 0.0;
+        }
+    }
+
     [[nodiscard]] Vector3
     at(numberType tNear) const { return pos + tNear * dir; }
+
+    // 方向所在的卦限 [0, 8)
+    [[nodiscard]] int
+    octant() const { return sign[0] | sign[1] << 1 | sign[2] << 2; }
 };
 
 }
@@ -0,0 +1,66 @@
+#ifndef ANYA_RENDERER_RAY_PACKET_HPP
+#define ANYA_RENDERER_RAY_PACKET_HPP
+
+#include "component/ray.hpp"
+#include "tool/simd.hpp"
+
+namespace anya {
+
+// 4条光线组成的光线包，起点、方向等按分量SoA存放，一组SIMD指令同时处理4条光线
+// 只有方向接近的光线(相邻像素的相机光线、射向同一光源的阴影光线)才值得打包，
+// 否则包内光线在BVH中走的路径各不相同，应退回逐条求交
+class RayPacket {
+public:
+    static constexpr int width = 4;           // 包内光线数
+    static constexpr int fullMask = 0xF;      // 所有通道均有效的掩码
+
+    alignas(32) numberType origin[3][width]{};     // origin[axis][lane]
+    alignas(32) numberType dir[3][width]{};
+    alignas(32) numberType invDir[3][width]{};
+    alignas(32) numberType tMax[width]{};          // 每条光线的求交上限，找到更近的交点后缩小
+    int active = 0;                                // 有效光线的掩码，不足4条时其余通道无效
+
+public:
+    RayPacket() = default;
+
+    // 由count(不超过4)条光线构造，无效通道复制第一条光线，保证参与计算时不会产生额外的NaN
+    RayPacket(const Ray* rays, const numberType* t, int count) {
+        for (int lane = 0; lane < width; ++lane) {
+            int k = lane < count ? lane : 0;
+            for (int axis = 0; axis < 3; ++axis) {
+                origin[axis][lane] = rays[k].pos[axis];
+                dir[axis][lane] = rays[k].dir[axis];
+                invDir[axis][lane] = rays[k].invDir[axis];
+            }
+            tMax[lane] = t[k];
+        }
+        active = (1 << count) - 1;
+    }
+
+public:
+    // 第lane条光线
+    [[nodiscard]] Ray
+    ray(int lane) const {
+        return { Vector3{ origin[0][lane], origin[1][lane], origin[2][lane] },
+                 Vector3{ dir[0][lane], dir[1][lane], dir[2][lane] } };
+    }
+
+    // 包内光线方向是否足够一致，值得按包遍历: 各分量同号，且与第一条光线的夹角余弦不小于minCos
+    [[nodiscard]] static bool
+    coherent(const Ray* rays, int count, numberType minCos = 0.9) {
+        const Vector3& d0 = rays[0].dir;
+        numberType len0 = d0.norm2();
+        for (int i = 1; i < count; ++i) {
+            const Vector3& d = rays[i].dir;
+            for (int axis = 0; axis < 3; ++axis) {
+                if (rays[i].sign[axis] != rays[0].sign[axis]) return false;
+            }
+            if (d.dot(d0) < minCos * len0 * d.norm2()) return false;
+        }
+        return true;
+    }
+};
+
+}
+
+#endif //ANYA_RENDERER_RAY_PACKET_HPP
@@ -10,6 +10,7 @@
 #include "interface/object.hpp"
 #include "component/light.hpp"
 #include "accelerator/BVH.hpp"
+#include "accelerator/light_distribution.hpp"
 
 namespace anya {
 
@@ -22,6 +23,7 @@ public:
 
     std::shared_ptr<Camera> camera;                 // 摄像机
     std::shared_ptr<BVH> bvh = nullptr;             // 层次包围盒
+    std::shared_ptr<LightDistribution> lightDistribution = nullptr; // 面光源的采样分布
 public:
     void
     addModel(const Model& model) {
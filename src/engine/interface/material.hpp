@@ -10,6 +10,7 @@ namespace anya {
 // 前置声明
 struct HitData;
 class RayTracer;
+class Sampler;
 
 enum MaterialType {
     DIFFUSE_AND_GLOSSY,
@@ -17,6 +18,14 @@ enum MaterialType {
     MIRROR
 };
 
+// 一次BSDF采样的结果，方向均从着色点指向外侧
+struct BSDFSample {
+    Vector3 wi{};           // 采样得到的方向
+    Vector3 f{};            // 该方向上的BSDF值
+    numberType pdf = 0.0;   // 立体角pdf，delta分布时为1
+    bool delta = false;     // 是否来自delta分布(如理想镜面)，此时无法与光源采样做MIS
+};
+
 class Material {
 public:
     // 材质类型
@@ -38,14 +47,24 @@ public:
     Vector3 Kd{};
 
 public:
-    [[nodiscard]] virtual Vector3
-    BXDF(const Vector3& wi, const Vector3& wo, const Vector3& normal) const = 0;
+#pragma region path_tracing api
+    // 以下接口的 wo, wi 都从着色点指向外侧，wo 为观察方向
+    // 按BSDF(乘以余弦项)的形状采样一个方向
+    [[nodiscard]] virtual BSDFSample
+    sampleBSDF(const Vector3& wo, const Vector3& normal, Sampler& sampler) const = 0;
 
+    // BSDF值，delta分布恒为0
     [[nodiscard]] virtual Vector3
-    sample(const Vector3& wi, const Vector3& normal) const = 0;
+    evalBSDF(const Vector3& wo, const Vector3& wi, const Vector3& normal) const = 0;
 
+    // sampleBSDF采样到wi的立体角pdf，delta分布恒为0
     [[nodiscard]] virtual numberType
-    pdf(const Vector3& wi, const Vector3& wo, const Vector3& normal) const = 0;
+    pdfBSDF(const Vector3& wo, const Vector3& wi, const Vector3& normal) const = 0;
+
+    // 是否只包含delta分布
+    [[nodiscard]] virtual bool
+    isDelta() const { return false; }
+#pragma endregion
 
 protected:
     static Vector3
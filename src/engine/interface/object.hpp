@@ -7,11 +7,16 @@
 
 #include "interface/material.hpp"
 #include "accelerator/AABB.hpp"
+#include "tool/sampler.hpp"
+#include "component/ray_packet.hpp"
+#include "tool/matrix.hpp"
 #include <memory>
+#include <stdexcept>
 
 namespace anya {
 
 struct HitData;
+struct HitRecord;
 
 class Object: public std::enable_shared_from_this<Object> {
 public:
@@ -33,14 +38,44 @@ public:
     // 获取包围盒
     [[nodiscard]] virtual AABB getBoundingBox() const = 0;
 
+    // 最近交点查询: 光线在 (0, rec.t) 内与object相交时，用更近的交点更新rec并返回true
+    // 遍历过程中只记录距离、图元编号与重心坐标，不计算法线等属性，也不复制智能指针
+    virtual bool intersect(const Ray& ray, HitRecord& rec) = 0;
+
+    // 由intersect得到的最近交点重建完整的相交信息，每条光线只调用一次
+    [[nodiscard]] virtual HitData interaction(const Ray& ray, const HitRecord& rec) = 0;
+
     // 返回光线与object的相交结果
-    [[nodiscard]] virtual std::optional<HitData> getIntersect(const Ray& ray) = 0;
+    [[nodiscard]] std::optional<HitData> getIntersect(const Ray& ray);
+
+    // 可见性查询: 光线在 (0, tMax) 内是否被object遮挡，只需要是/否的结果，子类可以提前终止且不必构造HitData
+    [[nodiscard]] virtual bool occludes(const Ray& ray, numberType tMax);
+
+    // 光线包的最近交点查询: mask中的每条光线在 (0, packet.tMax) 内求交，命中时更新recs与packet.tMax的对应通道
+    // 默认逐条光线调用intersect，网格与实例改写为按包遍历
+    virtual void intersect(RayPacket& packet, HitRecord* recs, int mask);
+
+    // 光线包的可见性查询: 返回mask中被object遮挡的光线的掩码，默认逐条光线调用occludes
+    [[nodiscard]] virtual int occludes(const RayPacket& packet, int mask);
 
     // 返回物体面积
     virtual numberType getArea() const = 0;
 
-    // 采样
-    virtual std::pair<HitData, numberType> sample() const = 0;
+    // 在物体表面按面积均匀采样一点，返回采样点与其面积pdf
+    virtual std::pair<HitData, numberType> sample(Sampler& sampler) const = 0;
+
+    // 光源采样相关: object由几个可以单独采样的图元组成，网格为三角形个数
+    [[nodiscard]] virtual int primitiveCount() const { return 1; }
+
+    // 第id个图元的面积
+    [[nodiscard]] virtual numberType primitiveArea(int) const { return getArea(); }
+
+    // 第id个图元经过仿射变换transform后的面积，实例用它得到世界空间的面积
+    // 默认只支持相似变换(旋转 + 均匀缩放 + 平移)，平面图元应按变换后的顶点重新计算
+    [[nodiscard]] virtual numberType transformedArea(int id, const Matrix44& transform) const;
+
+    // 在第id个图元上按面积均匀采样，返回采样点与其在该图元上的面积pdf
+    virtual std::pair<HitData, numberType> samplePrimitive(int id, Sampler& sampler) const;
 
     // 物体是否是光源的一部分
     bool isLight() const { return material != nullptr && material->isLight; }
@@ -59,6 +94,78 @@ struct HitData {
     std::shared_ptr<Object> hitObject = nullptr;
 };
 
+// 遍历阶段使用的轻量相交记录
+struct HitRecord {
+    static constexpr int maxInstanceDepth = 4;  // 实例的最大嵌套层数
+
+    numberType t = KMAX;            // 当前最近交点的距离，同时作为遍历的上限
+    numberType u = 0.0, v = 0.0;    // 三角形重心坐标的beta和gamma
+    int primId = -1;                // 命中的图元在object内的编号，如网格中的三角形下标
+    Object* object = nullptr;       // 命中的几何体
+    Object* instances[maxInstanceDepth]{};  // 命中路径上的实例，由内向外存放
+    int instanceDepth = 0;
+
+    // 从最外层的实例开始重建相交信息
+    [[nodiscard]] HitData
+    resolve(const Ray& ray) const {
+        Object* top = instanceDepth > 0 ? instances[instanceDepth - 1] : object;
+        return top->interaction(ray, *this);
+    }
+};
+
+inline std::optional<HitData>
+Object::getIntersect(const Ray& ray) {
+    HitRecord rec{};
+    if (!intersect(ray, rec)) return {};
+    return rec.resolve(ray);
+}
+
+inline std::pair<HitData, numberType>
+Object::samplePrimitive(int, Sampler& sampler) const {
+    return sample(sampler);
+}
+
+inline numberType
+Object::transformedArea(int id, const Matrix44& transform) const {
+    // M^T M = s^2 I 时面积缩放s^2，否则曲面的面积没有闭式解
+    auto m = transform.to<3, 3>();
+    auto gram = m.transpose() * m;
+    numberType s2 = (gram(0, 0) + gram(1, 1) + gram(2, 2)) / 3;
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            if (std::fabs(gram(i, j) - (i == j ? s2 : 0.0)) > 1e-6 * s2) {
+                throw std::runtime_error("Object::transformedArea: non-uniform scale is only supported for triangles");
+            }
+        }
+    }
+    return primitiveArea(id) * s2;
+}
+
+inline void
+Object::intersect(RayPacket& packet, HitRecord* recs, int mask) {
+    for (int lane = 0; lane < RayPacket::width; ++lane) {
+        if (!(mask >> lane & 1)) continue;
+        recs[lane].t = packet.tMax[lane];
+        if (intersect(packet.ray(lane), recs[lane])) packet.tMax[lane] = recs[lane].t;
+    }
+}
+
+inline int
+Object::occludes(const RayPacket& packet, int mask) {
+    int ret = 0;
+    for (int lane = 0; lane < RayPacket::width; ++lane) {
+        if ((mask >> lane & 1) && occludes(packet.ray(lane), packet.tMax[lane])) ret |= 1 << lane;
+    }
+    return ret;
+}
+
+inline bool
+Object::occludes(const Ray& ray, numberType tMax) {
+    HitRecord rec{};
+    rec.t = tMax;
+    return intersect(ray, rec);
+}
+
 }
 
 #endif //ANYA_RENDERER_OBJECT_HPP
@@ -8,11 +8,13 @@
 #include <memory>
 #include "component/camera.hpp"
 #include "component/scene.hpp"
+#include "tool/stats.hpp"
+#include "tool/heatmap.hpp"
 
 namespace anya {
 
 enum class RenderMode {
-    RASTERIZER, WHITTED_STYLE, PATH_TRACING
+    RASTERIZER, WHITTED_STYLE, PATH_TRACING, PATH_TRACING_MIS
 };
 
 class Renderer {
@@ -22,7 +24,14 @@ public:
     std::shared_ptr<Texture> outPutImage{};       // 输出图片
     std::string savePathName;                     // 保存路径
     int spp = 1;                                  // 采样频率
+    int threads = 0;                              // 渲染线程数, 0表示使用全部核心
+    std::uint32_t seed = 0;                       // 随机数种子
     RenderMode mode = RenderMode::WHITTED_STYLE;  // 渲染模式
+    int maxDepth = 5;                             // 路径的最大弹射次数, whitted_style中为最大递归深度
+    int minDepth = 3;                             // 路径追踪从第minDepth次弹射起启用俄罗斯轮盘赌
+    RenderStats stats{};                          // 最近一次render()的统计计数
+    CostMetric heatmapMetric = CostMetric::NONE;  // 代价热力图的度量, NONE表示不生成
+    CostHeatmap heatmap{};                        // 最近一次render()的逐像素代价
 public:
     virtual void render() = 0;
     [[nodiscard]] virtual Vector3 getPixel(int x, int y) const = 0;
@@ -7,35 +7,56 @@
 
 #include "component/object/sphere.hpp"
 #include "component/object/mesh.hpp"
+#include "component/object/instance.hpp"
 #include "material/diffuse.hpp"
 #include "material/mirror.hpp"
+#include "renderer/rasterizer.hpp"
+#include "renderer/wavefront_raytracer.hpp"
 #include <memory>
+#include <unordered_map>
 
 namespace anya {
 
 class Context {
 public:
     std::shared_ptr<Renderer> _renderer;
+    double bvhBuildSeconds = 0.0;   // 本次加载中所有BVH(网格的底层BVH与场景的顶层BVH)的构建耗时之和(秒)
+
+private:
+    BVHConfig bvhConfig{};
+    TriangleTest triangleTest = TriangleTest::PRECOMPUTED;
+    // 已加载的网格资源，同一路径的网格只解析和构建一次，由多个实例共享
+    std::unordered_map<std::string, std::shared_ptr<Mesh>> meshCache;
 
 public:
-    void
+    // 加载失败时打印错误并返回false
+    bool
     loadFromJson(const json& config) {
         try {
             load(config);
         } catch (const std::exception& err) {
-            printf("loadFromJson error: %s", err.what());
+            printf("loadFromJson error: %s\n", err.what());
+            return false;
         }
+        return true;
     }
 
 private:
     void
     load(const json& config) {
+        ProfileScope profile("Context::load", "load");
         // 加载renderer字段
         json renderer = config["renderer"];
         this->_renderer = makeRenderer(renderer["type"]);
         this->_renderer->background = toVector3(renderer["background"]) / 255;
         this->_renderer->spp = renderer.value("spp", 1);
-        this->_renderer->mode = renderer["mode"] == "path_tracing" ? RenderMode::PATH_TRACING : RenderMode::WHITTED_STYLE;
+        this->_renderer->threads = renderer.value("threads", 0);
+        this->_renderer->seed = renderer.value("seed", 0u);
+        this->_renderer->mode = toRenderMode(renderer.value("mode", "whitted_style"));
+        // whitted_style每层递归分裂出反射与折射两条光线，默认深度较小
+        this->_renderer->maxDepth = renderer.value("maxDepth", this->_renderer->mode == RenderMode::WHITTED_STYLE ? 5 : 64);
+        this->_renderer->minDepth = renderer.value("minDepth", 3);
+        this->_renderer->heatmapMetric = toCostMetric(renderer.value("heatmap", "none"), renderer["type"]);
 
         // 加载camera字段
         json camera = config["camera"];
@@ -58,7 +79,16 @@ private:
                 this->_renderer->scene.addModel(toModel(item));
             }
         }
-        else if (renderer["type"] == "RayTracer") {
+        else if (renderer["type"] == "RayTracer" || renderer["type"] == "WavefrontRayTracer") {
+            // 加载BVH构建参数
+            json bvh = renderer.value("bvh", json::object());
+            bvhConfig.bins = bvh.value("bins", bvhConfig.bins);
+            bvhConfig.leafSize = bvh.value("leafSize", bvhConfig.leafSize);
+            bvhConfig.width = bvh.value("width", bvhConfig.width);
+            bvhConfig.threads = bvh.value("threads", this->_renderer->threads);
+            // 网格的三角形求交算法
+            triangleTest = renderer.value("triangleTest", "precomputed") == "watertight" ? TriangleTest::WATERTIGHT : TriangleTest::PRECOMPUTED;
+
             // 加载objects字段
             json objects = config["objects"];
             for (const auto& item : objects) {
@@ -70,7 +100,11 @@ private:
                 this->_renderer->scene.addLight(toLight(item));
             }
             // 生成层次包围盒
-            this->_renderer->scene.bvh = std::make_shared<BVH>(this->_renderer->scene.objects);
+            this->_renderer->scene.bvh = std::make_shared<BVH>(this->_renderer->scene.objects, bvhConfig);
+            bvhBuildSeconds += this->_renderer->scene.bvh->buildSeconds;
+            // 收集发光图元，生成面光源的采样分布
+            ProfileScope lightProfile("LightDistribution", "load");
+            this->_renderer->scene.lightDistribution = std::make_shared<LightDistribution>(this->_renderer->scene.objects);
 
             // 锁定摄像机
             this->_renderer->scene.camera->isLock = true;
@@ -131,7 +165,7 @@ private:
         return model;
     }
 
-    static std::shared_ptr<Object>
+    std::shared_ptr<Object>
     toObject(const json& item) {
         std::string type = item["type"];
         if (type == "sphere") {
@@ -222,15 +256,39 @@ private:
         return triangle;
     }
 
-    static std::shared_ptr<Object>
+    std::shared_ptr<Object>
     toMesh(const json& obj) {
         auto material = toMaterial(obj["material"]);
         material->kd = 0.6;
         material->ks = 0.0;
         material->specularExponent = 0.0;
-        // 加载mesh的obj
-        std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>(obj["meshPath"], material);
-        return mesh;
+        // 加载mesh的obj，同一个obj只加载一次并构建底层BVH
+        std::string meshPath = obj["meshPath"];
+        auto& mesh = meshCache[meshPath];
+        if (mesh == nullptr) {
+            mesh = std::make_shared<Mesh>(meshPath, material, bvhConfig, triangleTest);
+            bvhBuildSeconds += mesh->bvhBuildSeconds();
+        }
+        // 场景中放置的是网格的实例，携带自己的变换与材质
+        return std::make_shared<Instance>(mesh, material, toTransform(obj.value("transform", json::object())));
+    }
+
+    // 变换顺序为 先缩放，再旋转，最后平移
+    static Matrix44
+    toTransform(const json& transform) {
+        Matrix44 ret = Matrix44::Identity();
+        if (transform.contains("scale")) {
+            json scale = transform["scale"];
+            ret = (scale.is_array() ? Transform::scale(toVector3(scale)) : Transform::scale(scale.get<numberType>())) * ret;
+        }
+        if (transform.contains("rotate")) {
+            json rotate = transform["rotate"];
+            ret = Transform::RotateAroundN(rotate["angle"], toVector3(rotate["axis"])) * ret;
+        }
+        if (transform.contains("translate")) {
+            ret = Transform::translate(toVector3(transform["translate"])) * ret;
+        }
+        return ret;
     }
 
     static Light
@@ -238,6 +296,31 @@ private:
         return Light{ toVector3(obj["position"]), toVector3(obj["intensity"]) };
     }
 
+    static RenderMode
+    toRenderMode(const std::string& mode) {
+        if (mode == "path_tracing") {
+            return RenderMode::PATH_TRACING;
+        }
+        else if (mode == "path_tracing_mis") {
+            return RenderMode::PATH_TRACING_MIS;
+        }
+        return RenderMode::WHITTED_STYLE;
+    }
+
+    // 代价热力图的度量，渲染器不支持的度量视为配置错误
+    static CostMetric
+    toCostMetric(const std::string& name, const std::string& type) {
+        auto metric = CostHeatmap::toMetric(name);
+        bool rasterizer = type == "Rasterizer";
+        if ((metric == CostMetric::NODES && rasterizer) || (metric == CostMetric::FRAGMENTS && !rasterizer)) {
+            throw std::runtime_error("heatmap metric " + name + " is not supported by " + type);
+        }
+        if (!renderStatsEnabled && (metric == CostMetric::NODES || (metric == CostMetric::PRIMITIVES && !rasterizer))) {
+            throw std::runtime_error("heatmap metric " + name + " requires ANYA_RENDER_STATS");
+        }
+        return metric;
+    }
+
     static std::shared_ptr<Renderer>
     makeRenderer(const std::string& type) {
         if (type == "Rasterizer") {
@@ -246,6 +329,9 @@ private:
         else if (type == "RayTracer") {
             return std::make_shared<RayTracer>();
         }
+        else if (type == "WavefrontRayTracer") {
+            return std::make_shared<WavefrontRayTracer>();
+        }
         else {
             throw std::runtime_error("renderer type error");
         }
@@ -14,6 +14,7 @@
 #include "shader/fragment_shader.hpp"
 #include "load/texture.hpp"
 #include "shader/methods.hpp"
+#include "tool/profiler.hpp"
 
 namespace anya {
 
@@ -30,6 +31,7 @@ public:
     // 从本地加载obj文件的数据
     void
     loadFromDisk(const std::string& modelPath) {
+        ProfileScope profile("Model::loadFromDisk", "load", modelPath);
         std::ifstream ifs(modelPath);
         if (!ifs.is_open()) {
             std::cerr << "can not find the " + modelPath << std::endl;
@@ -5,15 +5,19 @@
 #ifndef ANYA_ENGINE_TEXTURE_HPP
 #define ANYA_ENGINE_TEXTURE_HPP
 
+// stb的实现以static方式编译进每个包含本头文件的翻译单元，多个源文件同时包含时不会重复定义
+#define STB_IMAGE_STATIC
 #define STB_IMAGE_IMPLEMENTATION	// include之前必须定义
 #include "STB/stb_image.h"
 #undef STB_IMAGE_IMPLEMENTATION
 
+#define STB_IMAGE_WRITE_STATIC
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "STB/stb_image_write.h"
 #undef STB_IMAGE_WRITE_IMPLEMENTATION
 
 #include "tool/utils.hpp"
+#include "tool/profiler.hpp"
 
 // stb的库像素数据都是从左到右，从上到下存储
 // 我们要转为通用纹理坐标，左下角为(0,0) , 右上角为(width-1, height-1)
@@ -22,13 +26,14 @@ namespace anya {
 
 class Texture {
 private:
-    std::vector<Vector3> colors;   // 纹理颜色信息
+    std::vector<Vector3f> colors;  // 纹理颜色信息，单精度存放，读写时与Vector3互相转换
     int width = 0, height = 0;     // 图片的长宽
     int n = 0;                     // 图片自身的颜色的通道数
     static constexpr int bpp = 3;  // 自己设置的颜色通道数
 
 public:
     explicit Texture(const std::string& path) {
+        ProfileScope profile("Texture::decode", "load", path);
         unsigned char* data = stbi_load(path.c_str(), &width, &height, &n, bpp);
         if (data == nullptr) {
             std::cerr << "ERROR IMAGE NOT FOUND" << std::endl;
@@ -40,7 +45,7 @@ public:
         }
     }
 
-    explicit Texture(int w, int h, Vector3 bg): width(w), height(h), colors(w * h, bg)
+    explicit Texture(int w, int h, Vector3 bg): width(w), height(h), colors(w * h, Vector3f(bg))
     {}
 
     Texture() = default;
@@ -54,7 +59,7 @@ public:
                 numberType r = data[k * bpp];
                 numberType g = data[k * bpp + 1];
                 numberType b = data[k * bpp + 2];
-                colors[j + i * width] = Vector3 {r, g, b};
+                colors[j + i * width] = Vector3f(Vector3 {r, g, b});
             }
         }
     }
@@ -76,25 +81,32 @@ public:
         return buffer;
     }
 
-    void
+    // 按后缀名(bmp, png, jpg)保存，写入成功时返回true
+    bool
     saveToDisk(const std::string& path) const {
         auto it = path.find_last_of('.');
         if (it == std::string::npos) {
             std::cerr << "An illegal path!" << std::endl;
-            return;
+            return false;
         }
         std::string ext = path.substr(it + 1);
+        ProfileScope profile("Texture::encode", "io", path);
         auto buffer = generateBuffer();
 
+        int ok = 0;
         if (ext == "bmp") {
-            stbi_write_bmp(path.c_str(), width, height, bpp, buffer.data());
+            ok = stbi_write_bmp(path.c_str(), width, height, bpp, buffer.data());
         }
         else if (ext == "png") {
-            stbi_write_png(path.c_str(), width, height, bpp, buffer.data(), 0);
+            ok = stbi_write_png(path.c_str(), width, height, bpp, buffer.data(), 0);
         }
         else if (ext == "jpg") {
-            stbi_write_jpg(path.c_str(), width, height, bpp, buffer.data(), 100);
+            ok = stbi_write_jpg(path.c_str(), width, height, bpp, buffer.data(), 100);
+        }
+        else {
+            std::cerr << "Unsupported image format: " << ext << std::endl;
         }
+        return ok != 0;
     }
 
 public:
@@ -110,7 +122,7 @@ public:
         if (out_range(u_img, v_img)) {
             throw std::out_of_range("Texture::getColor");
         }
-        return colors[u_img + v_img * width];
+        return Vector3(colors[u_img + v_img * width]);
     }
 
     // Bilinear 双线性插值
@@ -132,10 +144,10 @@ public:
             throw std::out_of_range("Texture::getColor");
         }
 
-        auto c00 = colors[int(u0 + v0 * width)];
-        auto c01 = colors[int(u0 + v1 * width)];
-        auto c10 = colors[int(u1 + v0 * width)];
-        auto c11 = colors[int(u1 + v1 * width)];
+        auto c00 = Vector3(colors[int(u0 + v0 * width)]);
+        auto c01 = Vector3(colors[int(u0 + v1 * width)]);
+        auto c10 = Vector3(colors[int(u1 + v0 * width)]);
+        auto c11 = Vector3(colors[int(u1 + v1 * width)]);
 
         auto c0 = MathUtils::lerp(s, c00, c10);
         auto c1 = MathUtils::lerp(s, c01, c11);
@@ -155,18 +167,18 @@ public:
     setPixel(int x, int y, Vector3 color) {
         if (out_range(x, y))
             throw std::out_of_range("Texture::setPixel(int x, int y)");
-        colors[x + y * width] = color;
+        colors[x + y * width] = Vector3f(color);
     }
 
     [[nodiscard]] Vector3
     getPixel(int x, int y) const {
         if (out_range(x, y))
             throw std::out_of_range("Texture::setPixel(int x, int y)");
-        return colors[x + y * width];
+        return Vector3(colors[x + y * width]);
     }
 
     void
-    clearWith(Vector3 bg = {0, 0, 0}) { colors.assign(width * height, bg); }
+    clearWith(Vector3 bg = {0, 0, 0}) { colors.assign(width * height, Vector3f(bg)); }
 
     [[nodiscard]] constexpr bool
     out_range(numberType u, numberType v) const {
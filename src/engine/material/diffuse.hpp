@@ -16,39 +16,35 @@ public:
     }
 
 public:
-    [[nodiscard]] Vector3
-    BXDF(const Vector3& wi, const Vector3& wo, const Vector3& normal) const override {
-        // return Kd / pi;
-        auto cosalpha = normal.dot(wo);
-        if (cosalpha > epsilon) {
-            return Kd / pi;
-        }
-        else {
-            return {};
-        }
+#pragma region path_tracing api
+    // 余弦加权采样半球，pdf = cos / pi，与BSDF乘余弦项的形状一致
+    [[nodiscard]] BSDFSample
+    sampleBSDF(const Vector3& wo, const Vector3& normal, Sampler& sampler) const override {
+        BSDFSample ret{};
+        auto x1 = sampler.get1D();
+        auto x2 = sampler.get1D();
+        auto r = std::sqrt(x1);
+        auto phi = 2.0 * pi * x2;
+        Vector3 localRay{ r * std::cos(phi), r * std::sin(phi), std::sqrt(std::max(0.0, 1.0 - x1)) };
+        ret.wi = toWorld(localRay, normal);
+        ret.f = evalBSDF(wo, ret.wi, normal);
+        ret.pdf = pdfBSDF(wo, ret.wi, normal);
+        return ret;
     }
 
     [[nodiscard]] Vector3
-    sample(const Vector3& wi, const Vector3& normal) const override {
-        auto x1 = MathUtils::getRandNum();
-        auto x2 = MathUtils::getRandNum();
-        auto z = std::fabs(1.0 - 2.0 * x1);
-        auto r = std::sqrt(1.0 - z * z);
-        auto phi = 2.0 * pi * x2;
-        Vector3 localRay{ r * std::cos(phi), r * std::sin(phi), z };
-        return toWorld(localRay, normal);
+    evalBSDF(const Vector3& wo, const Vector3& wi, const Vector3& normal) const override {
+        if (normal.dot(wo) > epsilon && normal.dot(wi) > 0.0) {
+            return Kd / pi;
+        }
+        return {};
     }
 
     [[nodiscard]] numberType
-    pdf(const Vector3& wi, const Vector3& wo, const Vector3& normal) const override {
-        // return wo.dot(normal) / pi;
-        if (wo.dot(normal) > epsilon) {
-            return 0.5 / pi;
-        }
-        else {
-            return 0.0;
-        }
+    pdfBSDF(const Vector3&, const Vector3& wi, const Vector3& normal) const override {
+        return std::max(0.0, normal.dot(wi)) / pi;
     }
+#pragma endregion
 };
 
 }
@@ -16,31 +16,33 @@ public:
     }
 
 public:
-    [[nodiscard]] Vector3
-    BXDF(const Vector3& wi, const Vector3& wo, const Vector3& normal) const override {
-        auto cosalpha = normal.dot(wo);
-        if (cosalpha > epsilon) {
-            return Kd / cosalpha;
-        }
-        else {
-            return {};
-        }
+#pragma region path_tracing api
+    // 理想镜面是delta分布，唯一的反射方向以概率1被采到，f中约去余弦项，使 f * cos / pdf = Kd
+    [[nodiscard]] BSDFSample
+    sampleBSDF(const Vector3& wo, const Vector3& normal, Sampler&) const override {
+        BSDFSample ret{};
+        auto cos = normal.dot(wo);
+        if (cos <= epsilon) return ret;
+        ret.wi = -wo + (2 * cos) * normal;
+        ret.f = Kd / cos;
+        ret.pdf = 1.0;
+        ret.delta = true;
+        return ret;
     }
 
     [[nodiscard]] Vector3
-    sample(const Vector3& wi, const Vector3& normal) const override {
-        return wi - (2 * (wi.dot(normal))) * normal;
+    evalBSDF(const Vector3&, const Vector3&, const Vector3&) const override {
+        return {};
     }
 
     [[nodiscard]] numberType
-    pdf(const Vector3& wi, const Vector3& wo, const Vector3& normal) const override {
-        if (wo.dot(normal) > epsilon) {
-            return 1 / pi;
-        }
-        else {
-            return 0.0;
-        }
+    pdfBSDF(const Vector3&, const Vector3&, const Vector3&) const override {
+        return 0.0;
     }
+
+    [[nodiscard]] bool
+    isDelta() const override { return true; }
+#pragma endregion
 };
 
 }
@@ -8,6 +8,7 @@
 #include "interface/renderer.hpp"
 #include "tool/utils.hpp"
 #include "accelerator/clip.hpp"
+#include "tool/profiler.hpp"
 
 // ģʵĹդȾ
 
@@ -24,16 +25,33 @@ private:
     std::vector<Vector3> frame_msaa; // MSAA 4
     std::vector<numberType> z_msaa;  // MSAA 4
 
-    GLdouble view_width = 0.0, view_height = 0.0;  // Ӵ
+    numberType view_width = 0.0, view_height = 0.0;  // Ӵ
     numberType fixed = 1.0;                        // ϵ
 
+    // η㡢դɫ׶ΣդֻȲԣͨȲԵĲΪƬԪ
+    // ɫ׶ٰդ˳ΪƬԪɫдƬԪдģδһ
+    struct Fragment {
+        int sample;                                // frame_msaaе±
+        int triangle;                              // ڱе±
+        numberType alpha, beta, gamma, fixed;      // ͸Уϵ
+    };
+    static constexpr int batchSize = 256;          // ÿ
+    static constexpr int fragmentBudget = 1 << 16; // ƬԪֵʱɫƬԪĴС
+    std::vector<Triangle> batch;                             // 任Ļռδ޳
+    std::vector<std::array<Vector4, 3>> batchViewSpace;      // ӦviewSpace
+    std::vector<std::tuple<int, int, int, int>> batchBounds; // դʱĻΧ
+    std::vector<Fragment> fragments;                         // ɫƬԪ
 
 
 public:
 #pragma region renderer
     void
     render() override {
+        ProfileScope profile("Rasterizer::render", "render");
+        stats.clear();
+        RenderStats::ThreadScope statsScope(stats);
         std::tie(view_width, view_height) = scene.camera->getWH();
+        heatmap.reset(heatmapMetric, static_cast<int>(view_width), static_cast<int>(view_height));
         // ʼbufferĴС   Ļ: Vector3{92, 121.0, 92.0} / 255   Ľ: Vector3{38.25, 38.25, 38.25} / 255
         frame_buf.assign(static_cast<long long>(view_width * view_height), this->background);
         z_buf.assign(static_cast<long long>(view_width * view_height), inf);
@@ -53,37 +71,21 @@ public:
         for (auto& model : scene.models) {
             // ȡÿmodelmodelMat
             auto modelMat = model.modelMat;
+            auto viewModelMat = viewMat * modelMat;
             MVP =  projectionMat * viewMat * modelMat;
-            invMat = (viewMat * modelMat).inverse().transpose();
-
-            for (auto triangle : model.TriangleList) {
-                // viewSpace㼯
-                std::vector<Vector4> viewSpace{};
-                for (auto& vertex : triangle.vertexes) {
-                    viewSpace.push_back(viewMat * modelMat * vertex);
-                    vertex = viewPortMat * MVP * vertex;
-                    // ͸ӳ
-                    auto w = vertex.w();
-                    vertex /= w;
-                    vertex.w() = w;
-                    // Ϣֵ
-                    vertex.z() = vertex.z() * f1 + f2;
+            invMat = viewModelMat.inverse().transpose();
+            // Ӵ任MVPϲΪһÿֻһξ
+            auto screenMat = viewPortMat * MVP;
+
+            // ƬԪ϶ʱһλύιդɫ
+            int count = static_cast<int>(model.TriangleList.size());
+            for (int begin = 0; begin < count;) {
+                begin = vertexStage(model, begin, viewModelMat, screenMat, f1, f2);
+                for (int first = 0; first < static_cast<int>(batch.size());) {
+                    int last = rasterStage(first);
+                    shadeStage(first, last, model.fragmentShader);
+                    first = last;
                 }
-
-                // ޳Ż
-                if (ClipUtils::back_face_culling(triangle)) continue;
-
-                for (auto& normal : triangle.normals) {
-                    // Է߽б任
-                    normal = invMat * normal;
-                }
-
-            #ifndef Z_BUFFER_TEST
-                triangle.setColor(0, 148, 121.0, 92.0);
-                triangle.setColor(1, 148, 121.0, 92.0);
-                triangle.setColor(2, 148, 121.0, 92.0);
-            #endif
-                drawTriangleWithMSAA(triangle, viewSpace, model.fragmentShader);
             }
         }
     }
@@ -99,7 +101,7 @@ public:
 private:
 #pragma region sample
     void
-    drawTriangle(const Triangle& triangle, const std::vector<Vector4>& viewSpace, FragmentShader& fragmentShader) {
+    drawTriangle(const Triangle& triangle, const std::array<Vector4, 3>& viewSpace, FragmentShader& fragmentShader) {
         // ε
         auto a = triangle.a();
         auto b = triangle.b();
@@ -124,53 +126,135 @@ private:
                         // Ҫǵõλ!!
                         fragmentShader.init(shadingcoords_lerp, color_lerp, normal_lerp.to<3>().normalize().to4(0), uv_lerp);
                         auto pixel_color = fragmentShader.process(fragmentShader);
+                        RenderStats::count(&RenderStats::fragmentsShaded);
                         frame_buf[getIndex(i, j)] = pixel_color;
                         outPutImage->setPixel(i, j, pixel_color);
                     }
+                    else {
+                        RenderStats::count(&RenderStats::depthRejects);
+                    }
                 }
             }
         }
     }
+#pragma endregion
 
-    void
-    drawTriangleWithMSAA(const Triangle& triangle, const std::vector<Vector4>& viewSpace, FragmentShader& fragmentShader) {
-        // ε
-        auto a = triangle.a();
-        auto b = triangle.b();
-        auto c = triangle.c();
-        // Χ
-        auto[left, right, floor, top] = getBoundingBox(a, b, c);
-        // MSAA׼
-        int pid = 0;               // ǰframe_msaaеλ
+private:
+#pragma region stage
+    // ׶: 任 [begin, begin + batchSize) ڵΣ͸ӳ뱳޳һ
+    int
+    vertexStage(const Model& model, int begin, const Matrix44& viewModelMat, const Matrix44& screenMat, numberType f1, numberType f2) {
+        ProfileScope profile("Rasterizer::vertex", "raster");
+        int end = std::min(begin + batchSize, static_cast<int>(model.TriangleList.size()));
+        batch.clear();
+        batchViewSpace.clear();
+        for (int t = begin; t < end; ++t) {
+            auto triangle = model.TriangleList[t];
+            // viewSpace㼯
+            std::array<Vector4, 3> viewSpace{};
+            viewModelMat.transform(triangle.vertexes.data(), viewSpace.data(), 3);
+            screenMat.transform(triangle.vertexes.data(), triangle.vertexes.data(), 3);
+            for (auto& vertex : triangle.vertexes) {
+                // ͸ӳ
+                auto w = vertex.w();
+                vertex /= w;
+                vertex.w() = w;
+                // Ϣֵ
+                vertex.z() = vertex.z() * f1 + f2;
+            }
+
+            // ޳Ż
+            if (ClipUtils::back_face_culling(triangle)) continue;
+
+            // Է߽б任
+            invMat.transform(triangle.normals.data(), triangle.normals.data(), 3);
+
+        #ifndef Z_BUFFER_TEST
+            triangle.setColor(0, 148, 121.0, 92.0);
+            triangle.setColor(1, 148, 121.0, 92.0);
+            triangle.setColor(2, 148, 121.0, 92.0);
+        #endif
+            batch.push_back(std::move(triangle));
+            batchViewSpace.push_back(viewSpace);
+        }
+        return end;
+    }
+
+    // դ׶: ӱfirstοʼÿص4ȲԣͨĲΪƬԪ
+    // ƬԪfragmentBudgetʱα߽紦ͣ£һդ
+    int
+    rasterStage(int first) {
+        ProfileScope profile("Rasterizer::raster", "raster");
+        fragments.clear();
+        batchBounds.resize(batch.size());
         const std::array<numberType, 4> dx = { 0.25, 0.25, 0.75, 0.75 };
         const std::array<numberType, 4> dy = { 0.25, 0.75, 0.25, 0.75 };
-        // z-buffer㷨
-        for (int j = floor; j <= top; ++j) {
-            for (int i = left; i <= right; ++i) {
-                pid = getIndex(i, j) * 4;
-                // 4ģ
-                for (int k = 0; k < 4; ++k) {
-                    if (insideTriangle(i + dx[k], j + dy[k], triangle.vertexes)) {
+        auto metric = heatmap.getMetric();
+        int t = first;
+        for (; t < static_cast<int>(batch.size()) && static_cast<int>(fragments.size()) < fragmentBudget; ++t) {
+            const auto& triangle = batch[t];
+            // Χ
+            batchBounds[t] = getBoundingBox(triangle.a(), triangle.b(), triangle.c());
+            auto[left, right, floor, top] = batchBounds[t];
+            // z-buffer㷨
+            for (int j = floor; j <= top; ++j) {
+                for (int i = left; i <= right; ++i) {
+                    int pid = getIndex(i, j) * 4;
+                    double before = metric == CostMetric::TIME ? heatmap.probe() : 0.0;
+                    for (int k = 0; k < 4; ++k) {
+                        if (!insideTriangle(i + dx[k], j + dy[k], triangle.vertexes)) continue;
                         // ȡֵ
                         auto[alpha, beta, gamma] = computeBarycentric2DWithFixed(i + dx[k], j + dy[k], triangle);
                         numberType z_lerp = MathUtils::interpolate(alpha, beta, gamma, triangle.vertexes[0].z(), triangle.vertexes[1].z(), triangle.vertexes[2].z(), fixed);
                         // Ȳ
                         if (z_lerp < z_msaa[pid + k]) {
                             z_msaa[pid + k] = z_lerp;
-                            auto normal_lerp = MathUtils::interpolate(alpha, beta, gamma, triangle.normals[0], triangle.normals[1], triangle.normals[2], fixed);
-                            auto color_lerp = MathUtils::interpolate(alpha, beta, gamma, triangle.colors[0], triangle.colors[1], triangle.colors[2], fixed);
-                            auto uv_lerp = MathUtils::interpolate(alpha, beta, gamma, triangle.uvs[0], triangle.uvs[1], triangle.uvs[2], fixed);
-                            auto shadingcoords_lerp = MathUtils::interpolate(alpha, beta, gamma, viewSpace[0], viewSpace[1], viewSpace[2], fixed);
-
-                            // Ҫǵõλ!!
-                            fragmentShader.init(shadingcoords_lerp, color_lerp, normal_lerp.to<3>().normalize().to4(0), uv_lerp);
-                            auto pixel_color = fragmentShader.process(fragmentShader);
-                            frame_msaa[pid + k] = pixel_color / 4;
+                            fragments.push_back({ pid + k, t, alpha, beta, gamma, fixed });
+                        }
+                        else {
+                            RenderStats::count(&RenderStats::depthRejects);
                         }
                     }
+                    if (metric == CostMetric::TIME) heatmap.add(i, j, heatmap.probe() - before);
+                    else if (metric == CostMetric::PRIMITIVES) heatmap.add(i, j, 1);
+                }
+            }
+        }
+        return t;
+    }
+
+    // ɫ׶: դ˳ΪƬԪֵԲɫٰ [first, last) ΰΧڵ4ϳ
+    void
+    shadeStage(int first, int last, FragmentShader& fragmentShader) {
+        ProfileScope profile("Rasterizer::shade", "raster");
+        auto metric = heatmap.getMetric();
+        for (const auto& fragment : fragments) {
+            double before = metric == CostMetric::TIME ? heatmap.probe() : 0.0;
+            const auto& triangle = batch[fragment.triangle];
+            const auto& viewSpace = batchViewSpace[fragment.triangle];
+            numberType alpha = fragment.alpha, beta = fragment.beta, gamma = fragment.gamma;
+            auto normal_lerp = MathUtils::interpolate(alpha, beta, gamma, triangle.normals[0], triangle.normals[1], triangle.normals[2], fragment.fixed);
+            auto color_lerp = MathUtils::interpolate(alpha, beta, gamma, triangle.colors[0], triangle.colors[1], triangle.colors[2], fragment.fixed);
+            auto uv_lerp = MathUtils::interpolate(alpha, beta, gamma, triangle.uvs[0], triangle.uvs[1], triangle.uvs[2], fragment.fixed);
+            auto shadingcoords_lerp = MathUtils::interpolate(alpha, beta, gamma, viewSpace[0], viewSpace[1], viewSpace[2], fragment.fixed);
+
+            // Ҫǵõλ!!
+            fragmentShader.init(shadingcoords_lerp, color_lerp, normal_lerp.to<3>().normalize().to4(0), uv_lerp);
+            auto pixel_color = fragmentShader.process(fragmentShader);
+            RenderStats::count(&RenderStats::fragmentsShaded);
+            frame_msaa[fragment.sample] = pixel_color / 4;
+            if (metric == CostMetric::TIME) addCost(fragment.sample, heatmap.probe() - before);
+            else if (metric == CostMetric::FRAGMENTS) addCost(fragment.sample, 1);
+        }
+        // MSAAϳ
+        for (int t = first; t < last; ++t) {
+            auto[left, right, floor, top] = batchBounds[t];
+            for (int j = floor; j <= top; ++j) {
+                for (int i = left; i <= right; ++i) {
+                    int pid = getIndex(i, j) * 4;
+                    frame_buf[getIndex(i, j)] = frame_msaa[pid] + frame_msaa[pid + 1] + frame_msaa[pid + 2] + frame_msaa[pid + 3];
+                    outPutImage->setPixel(i, j, frame_buf[getIndex(i, j)]);
                 }
-                frame_buf[getIndex(i, j)] = frame_msaa[pid] + frame_msaa[pid + 1] + frame_msaa[pid + 2] + frame_msaa[pid + 3];
-                outPutImage->setPixel(i, j, frame_buf[getIndex(i, j)]);
             }
         }
     }
@@ -190,6 +274,13 @@ private:
         return ab.cross(aq).dot(bc.cross(bq)) > 0 && ab.cross(aq).dot(ca.cross(cq)) > 0 && bc.cross(bq).dot(ca.cross(cq)) > 0;
     }
 
+    // Ѵۼڵأframe_msaa±갴зתͼƬ෴
+    void
+    addCost(int sample, double value) {
+        int index = sample / 4, width = static_cast<int>(view_width);
+        heatmap.add(index % width, static_cast<int>(view_height) - 1 - index / width, value);
+    }
+
     // ȡbuffer±
     [[nodiscard]] int
     getIndex(int x, int y) const {
@@ -9,21 +9,23 @@
 #include "interface/object.hpp"
 #include "tool/utils.hpp"
 #include "tool/progress.hpp"
+#include "tool/tile_scheduler.hpp"
+#include "tool/profiler.hpp"
+#include "component/ray_packet.hpp"
 #include <functional>
+#include <omp.h>
 
 namespace anya {
 
 // 本模块实现最基本的光线追踪成像渲染器
 class RayTracer: public Renderer {
-private:
+protected:
     // 帧缓存
     std::vector<Vector3> frame_buf;
     // 视窗长宽
-    GLdouble view_width = 0.0, view_height = 0.0;
-    // 光线追踪最大递归深度
-    int maxDepth = 5;
-    // 俄罗斯轮盘赌
-    numberType RussianRoulette = 0.8;
+    numberType view_width = 0.0, view_height = 0.0;
+    // 并行渲染的图块边长
+    int tileSize = 32;
 
 private:
     // 导入友元
@@ -34,56 +36,131 @@ public:
 #pragma region renderer方法
     void
     render() override {
+        ProfileScope profile("RayTracer::render", "render");
         std::tie(view_width, view_height) = scene.camera->getWH();
         frame_buf.assign(static_cast<long long>(view_width * view_height), this->background);
         Progress progress;
 
         auto start = std::chrono::steady_clock::now();
-        for (int j = 0; j < view_height; ++j) {
-            for (int i = 0; i < view_width; ++i) {
-                // 利用光线弹射着色函数返回颜色信息
-                Vector3 pixel_color{};
-                for (int k = 0; k < spp; ++k) {
-                    // 相机发出的光线
-                    auto ray = scene.camera->biuRay(i, j);
-                    auto fixed = this->mode == RenderMode::WHITTED_STYLE ? Vector3{ 1, 1, -1 } : Vector3{ -1, 1, 1 };
-                    ray.dir = ray.dir.mut(fixed);
-                    pixel_color += cast_ray(ray, 0) / spp;
-                }
-                // 将像素写入帧缓存
-                int x = i;
-                int y = static_cast<int>(view_height) - 1 - j;
-                frame_buf[getIndex(x, y)] = pixel_color;
-                outPutImage->setPixel(x, y, pixel_color);
+
+        // 将画面切分为图块，由工作窃取调度器分发给各个线程
+        int workers = threads > 0 ? threads : omp_get_max_threads();
+        TileScheduler scheduler(static_cast<int>(view_width), static_cast<int>(view_height), tileSize, workers);
+        int finished = 0;
+        spin_lock progressLock;
+        stats.clear();
+        heatmap.reset(heatmapMetric, static_cast<int>(view_width), static_cast<int>(view_height));
+
+        #pragma omp parallel num_threads(workers)
+        {
+            RenderStats::ThreadScope statsScope(stats);
+            int worker = omp_get_thread_num();
+            while (auto tile = scheduler.next(worker)) {
+                renderTile(tile.value());
+                std::lock_guard guard(progressLock);
+                progress.update(double(++finished) / scheduler.tileCount());
             }
-            progress.update(double(j) / view_height);
         }
         progress.update(1.0);
-        auto end = std::chrono::steady_clock::now();
+        report(start, workers);
+    }
 
-        auto time_diff = end - start;
+    // 获取像素信息
+    [[nodiscard]] Vector3
+    getPixel(int x, int y) const override {
+        return frame_buf[getIndex(x, y)];
+    }
+
+protected:
+    // 输出渲染耗时
+    void
+    report(std::chrono::steady_clock::time_point start, int workers) const {
+        auto time_diff = std::chrono::steady_clock::now() - start;
         auto hours = std::chrono::duration_cast<std::chrono::hours>(time_diff);
         auto minutes = std::chrono::duration_cast<std::chrono::minutes>(time_diff - hours);
         auto seconds = std::chrono::duration_cast<std::chrono::seconds>(time_diff - hours - minutes);
-        std::cout << "\n\n\rSPP: " << this->spp << std::endl;
+        std::cout << "\n\n\rSPP: " << this->spp << ", Threads: " << workers << std::endl;
         std::cout << "Rendering Complete! \nTime Taken: " <<  hours.count() << " hours, " << minutes.count() << " minutes, " << seconds.count() << " seconds\n";
     }
 
-    // 获取像素信息
+    // 相机光线的方向修正，与光栅化的坐标系保持一致
     [[nodiscard]] Vector3
-    getPixel(int x, int y) const override {
-        return frame_buf[getIndex(x, y)];
+    rayFixed() const {
+        return this->mode == RenderMode::WHITTED_STYLE ? Vector3{ 1, 1, -1 } : Vector3{ -1, 1, 1 };
     }
 
 private:
+    // 渲染一个图块，每个像素只由一个线程写入，无需加锁
+    // 图块按2x2的像素块处理，同一样本序号下4个相邻像素的相机光线方向几乎一致，打包成光线包求第一个交点
+    void
+    renderTile(const Tile& tile) {
+        ProfileScope profile("RayTracer::tile", "render");
+        auto fixed = rayFixed();
+        for (int j0 = tile.y0; j0 < tile.y1; j0 += 2) {
+            for (int i0 = tile.x0; i0 < tile.x1; i0 += 2) {
+                // 块内的像素，图块边长为奇数时块可能不满
+                int px[RayPacket::width], py[RayPacket::width];
+                int count = 0;
+                for (int j = j0; j < std::min(j0 + 2, tile.y1); ++j) {
+                    for (int i = i0; i < std::min(i0 + 2, tile.x1); ++i) {
+                        px[count] = i;
+                        py[count] = j;
+                        ++count;
+                    }
+                }
+
+                // 利用光线弹射着色函数返回颜色信息
+                Vector3 pixel_color[RayPacket::width]{};
+                double pixel_cost[RayPacket::width]{};
+                for (int k = 0; k < spp; ++k) {
+                    Sampler samplers[RayPacket::width];
+                    Ray rays[RayPacket::width];
+                    for (int n = 0; n < count; ++n) {
+                        // 每个样本的随机数由 (像素, 样本序号, 种子) 唯一确定，保证结果与线程数无关
+                        auto pixel = static_cast<std::uint32_t>(py[n] * static_cast<int>(view_width) + px[n]);
+                        samplers[n] = Sampler(pixel, k, seed);
+                        // 相机发出的光线
+                        rays[n] = scene.camera->biuRay(px[n], py[n], samplers[n]);
+                        rays[n].setDir(rays[n].dir.mut(fixed));
+                    }
+                    HitRecord recs[RayPacket::width]{};
+                    RenderStats::count(&RenderStats::cameraRays, count);
+                    // 开启热力图时，光线包求交的代价由块内像素均分，其余代价计入各自的像素
+                    double before = heatmap.enabled() ? heatmap.probe() : 0.0;
+                    int hit = intersect(rays, count, recs);
+                    double shared = heatmap.enabled() ? (heatmap.probe() - before) / count : 0.0;
+                    for (int n = 0; n < count; ++n) {
+                        before = heatmap.enabled() ? heatmap.probe() : 0.0;
+                        std::optional<HitData> hitData;
+                        if (hit >> n & 1) hitData = recs[n].resolve(rays[n]);
+                        pixel_color[n] += cast_ray(rays[n], hitData, samplers[n]) / spp;
+                        if (heatmap.enabled()) pixel_cost[n] += shared + heatmap.probe() - before;
+                    }
+                }
+                // 将像素写入帧缓存
+                for (int n = 0; n < count; ++n) {
+                    int x = px[n];
+                    int y = static_cast<int>(view_height) - 1 - py[n];
+                    frame_buf[getIndex(x, y)] = pixel_color[n];
+                    outPutImage->setPixel(x, y, pixel_color[n]);
+                    if (heatmap.enabled()) heatmap.add(x, y, pixel_cost[n]);
+                }
+            }
+        }
+    }
+
+    // 由相机光线与它的第一个交点开始着色
     Vector3
-    cast_ray (const Ray& ray, int depth) {
+    cast_ray (const Ray& ray, const std::optional<HitData>& hitData, Sampler& sampler) {
         switch (mode) {
             case RenderMode::WHITTED_STYLE: {
-                return whitted_style(ray, depth);
+                return whitted_style(ray, hitData, 0);
             }
             case RenderMode::PATH_TRACING: {
-                return path_tracing(ray);
+                return path_tracing(ray, hitData, sampler, false);
+            }
+            case RenderMode::PATH_TRACING_MIS: {
+                return path_tracing(ray, hitData, sampler, true);
             }
             default: {
                 std::cerr << "Unknown RayTracer RenderMode Type!" << std::endl;
@@ -97,14 +174,13 @@ private:
 private:
 #pragma region 光追方法: whitted_style
     Vector3
-    whitted_style (const Ray& ray, int depth) {
+    whitted_style (const Ray& ray, const std::optional<HitData>& hitData, int depth) {
         // 到达递归最大深度，直接返回
         if (depth > maxDepth) {
             return Vector3{0, 0, 0};
         }
 
         Vector3 hitColor = this->background;
-        auto hitData = intersect(ray);
 
         if (hitData.has_value()) {
             Vector3 hitPoint = hitData->hitPoint;
@@ -124,15 +200,15 @@ private:
                         lightDir = lightDir.normalize();
                         numberType LdotN = std::fmax(0.0, lightDir.dot(normal));
 
-                        auto shadow_res = intersect({shadowPointOrig, lightDir});
-                        bool inShadow = shadow_res && (shadow_res->tNear * shadow_res->tNear < lightDistance2);
+                        bool inShadow = occluded({shadowPointOrig, lightDir}, std::sqrt(lightDistance2));
 
-                        ambient_light += inShadow ? Vector3{0, 0, 0} : light.intensity * LdotN;
+                        if (!inShadow) ambient_light.madd(light.intensity, LdotN);
                         Vector3 reflectionDirection = reflect(-lightDir, normal);
-                        specularColor += std::pow(std::fmax(0.0, -(reflectionDirection.dot(ray.dir))), hitData->hitObject->material->specularExponent) * light.intensity;
+                        specularColor.madd(light.intensity, std::pow(std::fmax(0.0, -(reflectionDirection.dot(ray.dir))), hitData->hitObject->material->specularExponent));
                     }
 
-                    hitColor = ambient_light.mut(hitData->hitObject->evalDiffuseColor(st)) * hitData->hitObject->material->kd + specularColor * hitData->hitObject->material->ks;
+                    hitColor = ambient_light.mut(hitData->hitObject->evalDiffuseColor(st), hitData->hitObject->material->kd);
+                    hitColor.madd(specularColor, hitData->hitObject->material->ks);
                     break;
                 }
                 case REFLECTION_AND_REFRACTION: {
@@ -145,8 +221,10 @@ private:
                                                 ? hitPoint - normal * epsilon
                                                 : hitPoint + normal * epsilon;
 
-                    Vector3 reflectionColor = whitted_style({ reflectionRayOrig, reflectionDirection }, depth + 1);
-                    Vector3 refractionColor = whitted_style({ refractionRayOrig, refractionDirection }, depth + 1);
+                    Ray reflectionRay{ reflectionRayOrig, reflectionDirection };
+                    Ray refractionRay{ refractionRayOrig, refractionDirection };
+                    Vector3 reflectionColor = whitted_style(reflectionRay, intersect(reflectionRay), depth + 1);
+                    Vector3 refractionColor = whitted_style(refractionRay, intersect(refractionRay), depth + 1);
 
                     numberType kr = fresnel(ray.dir, normal, hitData->hitObject->material->ior);
                     hitColor = reflectionColor * kr + refractionColor * (1 - kr);
@@ -163,93 +241,206 @@ private:
 
 #pragma endregion
 
-private:
+protected:
 #pragma region 光追方法: path_tracing
+    // 一条路径的状态，迭代式积分器每次弹射只更新这份状态而不递归
+    struct PathState {
+        Ray ray{};                          // 下一段光线
+        Vector3 L{};                        // 已累积的辐射度
+        Vector3 beta{ 1.0, 1.0, 1.0 };      // 路径吞吐量
+        numberType bsdfPdf = 0.0;           // 上一次BSDF采样的立体角pdf
+        bool specular = true;               // 上一次弹射是否为delta分布，相机光线视为delta
+        int depth = 0;                      // 已弹射的次数
+    };
+
+    // 光源采样生成的阴影光线，未被遮挡时把contribution计入路径
+    struct ShadowRay {
+        Ray ray{};
+        numberType tMax = 0.0;              // 为0表示本次没有光源采样
+        Vector3 contribution{};             // 已乘上路径吞吐量的贡献
+    };
+
+    // 迭代式路径追踪，从相机光线的第一个交点hitData开始，每个非delta的顶点做一次光源采样与一次BSDF采样:
+    //   mis为真(path_tracing_mis)时两者都计入光源的贡献，按幂启发式加权
+    //   mis为假(path_tracing)时光源只由光源采样计入，BSDF采样打到光源时丢弃，delta弹射之后除外
+    // 弹射次数达到minDepth后按吞吐量做俄罗斯轮盘赌，达到maxDepth后截断
     Vector3
-    path_tracing (const Ray& ray) {
-        auto hitData = intersect(ray);
-        if (!hitData.has_value()) return Vector3{};
-        return shade(hitData.value(), -ray.dir);
-    }
-
-    Vector3
-    shade(HitData& hitData, Vector3 wo) {
-        // 打到光源直接返回
-        if (hitData.hitObject->isLight()) {
-            return hitData.hitObject->getEmission();
+    path_tracing (const Ray& cameraRay, std::optional<HitData> hitData, Sampler& sampler, bool mis) {
+        PathState path{ cameraRay };
+        while (hitData.has_value()) {
+            ShadowRay shadow{};
+            bool alive = scatter(path, hitData.value(), sampler, mis, shadow);
+            if (shadow.tMax > 0.0 && !occluded(shadow.ray, shadow.tMax)) {
+                path.L += shadow.contribution;
+            }
+            if (!alive) break;
+            hitData = intersect(path.ray);
         }
+        RenderStats::local().addPath(path.depth);
+        return path.L;
+    }
 
-        // 直接光照贡献
-        Vector3 Lo_dir;
-        if (hitData.hitObject->material->type != MIRROR) {
-            auto [hitLight, pdf] = sampleLight();
-            Vector3 obj2Light = hitLight.hitPoint - hitData.hitPoint;
-            Vector3 obj2LightDir = obj2Light.normalize();
-
-            // 检查光线是否被物体阻挡
-            auto temp = intersect({hitData.hitPoint, obj2LightDir});
-            if (temp->tNear - obj2Light.norm2() > -epsilon) {
-                auto bxdf = hitData.hitObject->material->BXDF(obj2LightDir, wo, hitData.normal);
-                auto r2 = obj2Light.dot(obj2Light);
-                auto cosA = std::max(0.0, hitData.normal.dot(obj2LightDir));
-                auto cosB = std::max(0.0, hitLight.normal.dot(-obj2LightDir));
-                Lo_dir = hitLight.radiance.mut(bxdf) * cosA * cosB / (r2 * pdf);
+    // 在交点hit处推进一次路径: 计入打到光源的贡献，生成光源采样的阴影光线，并采样下一段光线
+    // 只消耗随机数而不做任何求交，求交由调用者完成，因此逐条光线与成批处理的积分器共用同一份着色逻辑
+    // 返回路径是否继续
+    bool
+    scatter(PathState& path, const HitData& hit, Sampler& sampler, bool mis, ShadowRay& shadow) const {
+        Vector3 wo = -path.ray.dir;
+        // 打到光源，光源只向法线一侧发光，光源本身不再反射
+        if (hit.hitObject->isLight()) {
+            numberType cosLight = hit.normal.dot(wo);
+            if (cosLight > 0.0 && (path.specular || mis)) {
+                numberType weight = 1.0;
+                if (!path.specular) {
+                    // BSDF采样打到光源，换算出光源采样得到该点的立体角pdf
+                    numberType lightPdf = lightAreaPdf() * hit.tNear * hit.tNear / cosLight;
+                    weight = powerHeuristic(path.bsdfPdf, lightPdf);
+                }
+                path.L.madd(path.beta, hit.hitObject->getEmission(), weight);
             }
+            return false;
         }
+        if (path.depth >= maxDepth) return false;
 
+        const auto& material = hit.hitObject->material;
+        // 光源采样
+        if (!material->isDelta()) {
+            shadow = sampleDirect(hit, wo, sampler, mis);
+            shadow.contribution = path.beta.mut(shadow.contribution);
+        }
 
-        // 间接光照贡献
-        Vector3 Lo_indir;
-        {
-            auto num = MathUtils::getRandNum();
-            if (num < RussianRoulette) {
-                Vector3 light2NextObj = hitData.hitObject->material->sample(-wo, hitData.normal).normalize();
-                numberType pdf = hitData.hitObject->material->pdf(-wo, light2NextObj, hitData.normal);
-                if (pdf > epsilon) {
-                    auto nextHitData = intersect({ hitData.hitPoint, light2NextObj });
-                    if (nextHitData.has_value()) {
-                        auto bxdf = hitData.hitObject->material->BXDF(-light2NextObj, wo, hitData.normal);
-                        auto cos = std::max(0.0, light2NextObj.dot(hitData.normal));
-                        Lo_indir = shade(nextHitData.value(), -light2NextObj).mut(bxdf) * cos / (pdf * RussianRoulette);
-                    }
-                }
+        // BSDF采样，决定下一段路径
+        BSDFSample bs = material->sampleBSDF(wo, hit.normal, sampler);
+        numberType cos = std::fabs(bs.wi.dot(hit.normal));
+        if (bs.pdf <= 0.0 || bs.f.norm2() <= 0.0 || cos <= 0.0) return false;
+        path.beta = path.beta.mut(bs.f, cos / bs.pdf);
+        path.bsdfPdf = bs.pdf;
+        path.specular = bs.delta;
+
+        // 俄罗斯轮盘赌，存活概率取吞吐量的最大分量，暗淡的路径尽早结束
+        if (path.depth + 1 >= minDepth) {
+            numberType survive = std::min(1.0, path.beta.maxComponent());
+            if (sampler.get1D() >= survive) {
+                RenderStats::count(&RenderStats::rouletteTerminations);
+                return false;
             }
+            path.beta = path.beta / survive;
         }
 
-        return Lo_dir + Lo_indir;
+        Vector3 wi = bs.wi.normalize();
+        path.ray = { offsetOrigin(hit.hitPoint, hit.normal, wi), wi };
+        ++path.depth;
+        return true;
     }
 
-    // 对光源进行采样
+    // 光源采样估计直接光照，mis为真时按幂启发式与BSDF采样加权，可见性由返回的阴影光线决定
+    ShadowRay
+    sampleDirect(const HitData& hit, const Vector3& wo, Sampler& sampler, bool mis) const {
+        auto [hitLight, areaPdf] = sampleLight(sampler);
+        if (areaPdf <= 0.0) return {};
+        Vector3 obj2Light = hitLight.hitPoint - hit.hitPoint;
+        numberType distance = obj2Light.norm2();
+        Vector3 wi = obj2Light / distance;
+        numberType cosSurface = hit.normal.dot(wi);
+        numberType cosLight = hitLight.normal.dot(-wi);
+        if (cosSurface <= 0.0 || cosLight <= 0.0) return {};
+
+        const auto& material = hit.hitObject->material;
+        Vector3 f = material->evalBSDF(wo, wi, hit.normal);
+        if (f.norm2() <= 0.0) return {};
+
+        // 面积pdf换算为立体角pdf
+        numberType lightPdf = areaPdf * distance * distance / cosLight;
+        numberType weight = mis ? powerHeuristic(lightPdf, material->pdfBSDF(wo, wi, hit.normal)) : 1.0;
+        // 阴影光线从偏移后的起点指向光源上的采样点，tMax按相对误差略短于两点距离，光源自身不会挡住阴影光线
+        Vector3 origin = offsetOrigin(hit.hitPoint, hit.normal, wi);
+        Vector3 toLight = hitLight.hitPoint - origin;
+        numberType shadowDistance = toLight.norm2();
+        ShadowRay ret{};
+        ret.ray = { origin, toLight / shadowDistance };
+        ret.tMax = shadowDistance * (1 - 1e-6);
+        ret.contribution = hitLight.radiance.mut(f, cosSurface * weight / lightPdf);
+        return ret;
+    }
+
+    // 对光源进行采样，返回采样点与其面积pdf
     [[nodiscard]] std::pair<HitData, numberType>
-    sampleLight() const {
-        numberType areaSum = 0.0;
-        for (const auto& object : scene.objects) {
-            if (object->isLight()) {
-                areaSum += object->getArea();
-            }
-        }
-        auto limitArea = areaSum * MathUtils::getRandNum();
-        areaSum = 0.0;
-        for (const auto& object : scene.objects) {
-            if (object->isLight()) {
-                areaSum += object->getArea();
-                if (limitArea <= areaSum) {
-                    return object->sample();
-                }
-            }
-        }
-        return std::make_pair(HitData{}, 0.0);
+    sampleLight(Sampler& sampler) const {
+        if (scene.lightDistribution == nullptr) return std::make_pair(HitData{}, 0.0);
+        return scene.lightDistribution->sample(sampler);
+    }
+
+    // 光源上任意一点的面积pdf
+    [[nodiscard]] numberType
+    lightAreaPdf() const {
+        return scene.lightDistribution == nullptr ? 0.0 : scene.lightDistribution->areaPdf();
+    }
+
+    // 沿法线把新光线的起点推到方向w所在的一侧，避免与出发的表面自相交，偏移量随坐标的量级缩放
+    [[nodiscard]] static Vector3
+    offsetOrigin(const Vector3& p, const Vector3& normal, const Vector3& w) {
+        numberType scale = std::max({ std::fabs(p.x()), std::fabs(p.y()), std::fabs(p.z()), 1.0 }) * 1e-7;
+        return p + (w.dot(normal) > 0.0 ? scale : -scale) * normal;
+    }
+
+    // 幂启发式(beta = 2)的MIS权重
+    [[nodiscard]] static numberType
+    powerHeuristic(numberType fPdf, numberType gPdf) {
+        numberType f = fPdf * fPdf, g = gPdf * gPdf;
+        return f + g > 0.0 ? f / (f + g) : 0.0;
     }
 #pragma endregion
 
-private:
+protected:
 #pragma region 数学物理模型
-    // 相交
+    // 弹射光线的相交
     [[nodiscard]] std::optional<HitData>
     intersect(const Ray &ray) const {
+        RenderStats::count(&RenderStats::indirectRays);
         return this->scene.bvh->intersect(ray);
     }
 
+    // 可见性测试，光线在 (0, tMax) 内是否被遮挡
+    [[nodiscard]] bool
+    occluded(const Ray& ray, numberType tMax) const {
+        RenderStats::count(&RenderStats::shadowRays);
+        return this->scene.bvh->occluded(ray, tMax);
+    }
+
+    // 一组(至多4条)光线的最近交点，返回命中的光线的掩码，光线的种类由调用者计数
+    // 方向一致时打包成光线包遍历，否则逐条求交，两种方式得到的相交记录相同
+    int
+    intersect(const Ray* rays, int count, HitRecord* recs) const {
+        int ret = 0;
+        if (count > 1 && RayPacket::coherent(rays, count)) {
+            numberType tMax[RayPacket::width] = { KMAX, KMAX, KMAX, KMAX };
+            RayPacket packet(rays, tMax, count);
+            this->scene.bvh->intersect(packet, recs);
+            for (int n = 0; n < count; ++n) {
+                if (recs[n].object != nullptr) ret |= 1 << n;
+            }
+            return ret;
+        }
+        for (int n = 0; n < count; ++n) {
+            if (this->scene.bvh->intersect(rays[n], recs[n])) ret |= 1 << n;
+        }
+        return ret;
+    }
+
+    // 一组(至多4条)光线的可见性测试，返回在 (0, tMax) 内被遮挡的光线的掩码
+    int
+    occluded(const Ray* rays, const numberType* tMax, int count) const {
+        if (count > 1 && RayPacket::coherent(rays, count)) {
+            RenderStats::count(&RenderStats::shadowRays, count);
+            return this->scene.bvh->occluded(RayPacket(rays, tMax, count));
+        }
+        int ret = 0;
+        for (int n = 0; n < count; ++n) {
+            if (occluded(rays[n], tMax[n])) ret |= 1 << n;
+        }
+        return ret;
+    }
+
     // 反射
     [[nodiscard]] static Vector3
     reflect(const Vector3& wi, const Vector3& normal) {
@@ -296,7 +487,7 @@ private:
     }
 #pragma endregion
 
-private:
+protected:
 #pragma region 辅助函数
     // 获取buffer的下标
     [[nodiscard]] int
@@ -0,0 +1,299 @@
+#ifndef ANYA_RENDERER_WAVEFRONT_RAYTRACER_HPP
+#define ANYA_RENDERER_WAVEFRONT_RAYTRACER_HPP
+
+#include "renderer/raytracer.hpp"
+#include <numeric>
+
+namespace anya {
+
+// 波前式(流式)路径追踪渲染器
+// RayTracer逐条光线深度优先地追踪完整条路径，本渲染器一次生成一大批相机光线，
+// 按 生成 -> 延伸(求交) -> 着色 -> 连接(阴影光线) 四个阶段成批推进所有路径，直到全部终止
+// 阶段之间的光线放在SoA队列中，并按方向卦限与材质排序，
+// 同一阶段内相邻处理的光线在BVH中走相近的路径，着色时连续调用同一种材质的采样代码
+// 着色逻辑与RayTracer共用scatter，相同种子下两者的结果逐位一致
+// whitted_style模式不做成批处理，直接交给RayTracer
+class WavefrontRayTracer: public RayTracer {
+private:
+    // 光线队列(SoA)，每一项对应一条路径
+    struct RayQueue {
+        std::vector<int> paths;              // 路径编号
+        std::vector<Vector3> origins;        // 光线起点
+        std::vector<Vector3> directions;     // 光线方向
+        std::vector<numberType> tMax;        // 求交上限
+
+        void
+        clear() {
+            paths.clear();
+            origins.clear();
+            directions.clear();
+            tMax.clear();
+        }
+
+        void
+        push(int path, const Ray& ray, numberType t) {
+            paths.push_back(path);
+            origins.push_back(ray.pos);
+            directions.push_back(ray.dir);
+            tMax.push_back(t);
+        }
+
+        [[nodiscard]] int
+        size() const noexcept { return static_cast<int>(paths.size()); }
+    };
+
+    // 每批同时推进的路径数
+    int batchSize = 1 << 14;
+
+    // 当前批次中每条路径的状态，按路径编号索引
+    std::vector<PathState> paths;
+    std::vector<Sampler> samplers;
+    std::vector<HitRecord> records;          // 延伸阶段得到的最近交点
+    std::vector<HitData> interactions;       // 着色阶段重建的相交信息
+    std::vector<ShadowRay> shadows;          // 着色阶段生成的阴影光线
+
+    // 阶段之间传递的队列
+    std::vector<int> active;                 // 仍在追踪的路径
+    RayQueue extendQueue;                    // 待求交的光线
+    RayQueue shadowQueue;                    // 待测试可见性的阴影光线
+    std::vector<unsigned char> flags;        // 队列中每条光线的求交结果或路径是否继续
+
+public:
+#pragma region renderer方法
+    void
+    render() override {
+        // 波前式的一条光线在各阶段之间与其它像素的光线交错处理，无法按像素统计代价，热力图改由逐像素的积分器渲染
+        if ((mode != RenderMode::PATH_TRACING && mode != RenderMode::PATH_TRACING_MIS) || heatmapMetric != CostMetric::NONE) {
+            RayTracer::render();
+            return;
+        }
+        ProfileScope profile("WavefrontRayTracer::render", "render");
+        std::tie(view_width, view_height) = scene.camera->getWH();
+        int width = static_cast<int>(view_width), height = static_cast<int>(view_height);
+        frame_buf.assign(static_cast<long long>(width) * height, Vector3{});
+        Progress progress;
+
+        auto start = std::chrono::steady_clock::now();
+
+        int workers = threads > 0 ? threads : omp_get_max_threads();
+        stats.clear();
+        heatmap.reset(heatmapMetric, width, height);
+        // 第index条路径属于像素 index / spp 的第 index % spp 个样本
+        long long total = static_cast<long long>(width) * height * spp;
+        for (long long begin = 0; begin < total; begin += batchSize) {
+            long long end = std::min(total, begin + batchSize);
+            renderBatch(begin, end, workers, mode == RenderMode::PATH_TRACING_MIS);
+            progress.update(double(end) / double(total));
+        }
+
+        // 将帧缓存写入输出图片
+        for (int j = 0; j < height; ++j) {
+            for (int i = 0; i < width; ++i) {
+                outPutImage->setPixel(i, height - 1 - j, frame_buf[j * width + i]);
+            }
+        }
+        progress.update(1.0);
+        report(start, workers);
+    }
+
+#pragma endregion
+
+private:
+#pragma region 波前阶段
+    // 推进编号为 [begin, end) 的一批路径直到全部终止，并把结果累加到帧缓存
+    void
+    renderBatch(long long begin, long long end, int workers, bool mis) {
+        ProfileScope profile("WavefrontRayTracer::batch", "render");
+        int count = static_cast<int>(end - begin);
+        paths.assign(count, PathState{});
+        samplers.resize(count);
+        records.resize(count);
+        interactions.resize(count);
+        shadows.resize(count);
+
+        generate(begin, count, workers);
+        for (int bounce = 0; !active.empty(); ++bounce) {
+            extend(workers, bounce == 0);
+            shade(workers, mis);
+            connect(workers);
+        }
+
+        // 同一像素的样本按序号顺序累加，与RayTracer的求和顺序一致
+        for (int p = 0; p < count; ++p) {
+            frame_buf[(begin + p) / spp] += paths[p].L / spp;
+            stats.addPath(paths[p].depth);
+        }
+    }
+
+    // 生成: 为每条路径生成相机光线
+    void
+    generate(long long begin, int count, int workers) {
+        int width = static_cast<int>(view_width);
+        auto fixed = rayFixed();
+        #pragma omp parallel num_threads(workers)
+        {
+            // 各阶段的循环不在结尾同步，剖析区间只覆盖本线程的工作，等待其他线程的时间在时间线上显示为空闲
+            ProfileScope profile("WavefrontRayTracer::generate", "render");
+            #pragma omp for schedule(static) nowait
+            for (int p = 0; p < count; ++p) {
+                long long index = begin + p;
+                auto pixel = static_cast<std::uint32_t>(index / spp);
+                auto sample = static_cast<std::uint32_t>(index % spp);
+                samplers[p] = Sampler(pixel, sample, seed);
+                auto ray = scene.camera->biuRay(static_cast<int>(pixel) % width, static_cast<int>(pixel) / width, samplers[p]);
+                ray.setDir(ray.dir.mut(fixed));
+                paths[p] = PathState{ ray };
+            }
+        }
+        active.resize(count);
+        std::iota(active.begin(), active.end(), 0);
+    }
+
+    // 延伸: 按方向卦限排序后成批求交，未命中的路径终止，同一批路径同步弹射，第一次延伸的全部是相机光线
+    void
+    extend(int workers, bool camera) {
+        sortByKey(active, 8, [&](int p) { return paths[p].ray.octant(); });
+        extendQueue.clear();
+        for (int p : active) {
+            extendQueue.push(p, paths[p].ray, KMAX);
+        }
+
+        // 排序后相邻的4条光线组成一组，方向一致时按光线包求交
+        int n = extendQueue.size();
+        int groups = (n + RayPacket::width - 1) / RayPacket::width;
+        flags.assign(n, 0);
+        auto counter = camera ? &RenderStats::cameraRays : &RenderStats::indirectRays;
+        #pragma omp parallel num_threads(workers)
+        {
+            RenderStats::ThreadScope statsScope(stats);
+            ProfileScope profile("WavefrontRayTracer::extend", "render");
+            #pragma omp for schedule(static) nowait
+            for (int g = 0; g < groups; ++g) {
+                int first = g * RayPacket::width;
+                int count = std::min(RayPacket::width, n - first);
+                Ray rays[RayPacket::width];
+                HitRecord recs[RayPacket::width]{};
+                for (int k = 0; k < count; ++k) {
+                    rays[k] = { extendQueue.origins[first + k], extendQueue.directions[first + k] };
+                }
+                RenderStats::count(counter, count);
+                int hit = intersect(rays, count, recs);
+                for (int k = 0; k < count; ++k) {
+                    flags[first + k] = hit >> k & 1;
+                    records[extendQueue.paths[first + k]] = recs[k];
+                }
+            }
+        }
+
+        active.clear();
+        for (int i = 0; i < n; ++i) {
+            if (flags[i]) active.push_back(extendQueue.paths[i]);
+        }
+    }
+
+    // 着色: 重建相交信息，按材质排序后推进路径，收集阴影光线与继续追踪的路径
+    void
+    shade(int workers, bool mis) {
+        int n = static_cast<int>(active.size());
+        #pragma omp parallel num_threads(workers)
+        {
+            ProfileScope profile("WavefrontRayTracer::resolve", "render");
+            #pragma omp for schedule(static) nowait
+            for (int i = 0; i < n; ++i) {
+                int p = active[i];
+                interactions[p] = records[p].resolve(paths[p].ray);
+            }
+        }
+
+        // 光源排在最前，其余按材质类型，同种材质内再按入射方向的卦限
+        sortByKey(active, 4 * 8, [&](int p) {
+            const auto& object = interactions[p].hitObject;
+            int material = object->isLight() ? 0 : 1 + static_cast<int>(object->material->type);
+            return material * 8 + paths[p].ray.octant();
+        });
+
+        flags.assign(n, 0);
+        #pragma omp parallel num_threads(workers)
+        {
+            RenderStats::ThreadScope statsScope(stats);
+            ProfileScope profile("WavefrontRayTracer::shade", "render");
+            #pragma omp for schedule(static) nowait
+            for (int i = 0; i < n; ++i) {
+                int p = active[i];
+                shadows[p] = ShadowRay{};
+                flags[i] = scatter(paths[p], interactions[p], samplers[p], mis, shadows[p]);
+            }
+        }
+
+        std::vector<int> shadowPaths;
+        std::vector<int> alive;
+        for (int i = 0; i < n; ++i) {
+            int p = active[i];
+            if (shadows[p].tMax > 0.0) shadowPaths.push_back(p);
+            if (flags[i]) alive.push_back(p);
+        }
+        active.swap(alive);
+
+        sortByKey(shadowPaths, 8, [&](int p) { return shadows[p].ray.octant(); });
+        shadowQueue.clear();
+        for (int p : shadowPaths) {
+            shadowQueue.push(p, shadows[p].ray, shadows[p].tMax);
+        }
+    }
+
+    // 连接: 成批测试阴影光线的可见性，未被遮挡的光源采样计入路径，射向光源的方向一致的阴影光线按光线包测试
+    void
+    connect(int workers) {
+        int n = shadowQueue.size();
+        int groups = (n + RayPacket::width - 1) / RayPacket::width;
+        flags.assign(n, 0);
+        #pragma omp parallel num_threads(workers)
+        {
+            RenderStats::ThreadScope statsScope(stats);
+            ProfileScope profile("WavefrontRayTracer::connect", "render");
+            #pragma omp for schedule(static) nowait
+            for (int g = 0; g < groups; ++g) {
+                int first = g * RayPacket::width;
+                int count = std::min(RayPacket::width, n - first);
+                Ray rays[RayPacket::width];
+                for (int k = 0; k < count; ++k) {
+                    rays[k] = { shadowQueue.origins[first + k], shadowQueue.directions[first + k] };
+                }
+                int hit = occluded(rays, &shadowQueue.tMax[first], count);
+                for (int k = 0; k < count; ++k) {
+                    flags[first + k] = hit >> k & 1;
+                }
+            }
+        }
+        for (int i = 0; i < n; ++i) {
+            int p = shadowQueue.paths[i];
+            if (!flags[i]) paths[p].L += shadows[p].contribution;
+        }
+    }
+#pragma endregion
+
+private:
+#pragma region 辅助函数
+    // 按 [0, buckets) 内的整数键做稳定的计数排序，键相同的路径保持原有顺序
+    template<class KeyFunc>
+    static void
+    sortByKey(std::vector<int>& items, int buckets, KeyFunc key) {
+        std::vector<int> keys(items.size());
+        std::vector<int> offsets(buckets + 1, 0);
+        for (std::size_t i = 0; i < items.size(); ++i) {
+            keys[i] = key(items[i]);
+            ++offsets[keys[i] + 1];
+        }
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+        std::vector<int> sorted(items.size());
+        for (std::size_t i = 0; i < items.size(); ++i) {
+            sorted[offsets[keys[i]]++] = items[i];
+        }
+        items.swap(sorted);
+    }
+#pragma endregion
+};
+
+}
+
+#endif //ANYA_RENDERER_WAVEFRONT_RAYTRACER_HPP
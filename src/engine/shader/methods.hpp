@@ -57,9 +57,10 @@ struct ShaderUtils {
             Vector3 v = (eye_pos - point).normalize();         // 观察方向v
             Vector3 h = (l + v).normalize();                   // 半程向量
             numberType R2 = (point - light.position).dot((point - light.position)); // 距离的平方
+            Vector3 intensity = light.intensity / R2;                                // 到达着色点的光强
             ret += ka.mut(ambient_light_intensity);
-            ret += kd.mut(light.intensity / R2) * std::max(0.0, normal.dot(l));
-            ret += ks.mut(light.intensity / R2) * std::pow(std::max(0.0, normal.dot(h)), p);
+            ret.madd(kd, intensity, std::max(0.0, normal.dot(l)));
+            ret.madd(ks, intensity, std::pow(std::max(0.0, normal.dot(h)), p));
         }
 
         return ret;
@@ -98,9 +99,10 @@ struct ShaderUtils {
             Vector3 v = (eye_pos - point).normalize();         // 观察方向v
             Vector3 h = (l + v).normalize();                   // 半程向量
             numberType R2 = (point - light.position).dot((point - light.position)); // 距离的平方
+            Vector3 intensity = light.intensity / R2;                                // 到达着色点的光强
             ret += ka.mut(ambient_light_intensity);
-            ret += kd.mut(light.intensity / R2) * std::max(0.0, normal.dot(l));
-            ret += ks.mut(light.intensity / R2) * std::pow(std::max(0.0, normal.dot(h)), p);
+            ret.madd(kd, intensity, std::max(0.0, normal.dot(l)));
+            ret.madd(ks, intensity, std::pow(std::max(0.0, normal.dot(h)), p));
         }
         return ret;
     }
@@ -182,9 +184,10 @@ struct ShaderUtils {
             Vector3 v = (eye_pos - point).normalize();         // 观察方向v
             Vector3 h = (l + v).normalize();                   // 半程向量
             numberType R2 = (point - light.position).dot((point - light.position)); // 距离的平方
+            Vector3 intensity = light.intensity / R2;                                // 到达着色点的光强
             ret += ka.mut(ambient_light_intensity);
-            ret += kd.mut(light.intensity / R2) * std::max(0.0, normal.dot(l));
-            ret += ks.mut(light.intensity / R2) * std::pow(std::max(0.0, normal.dot(h)), p);
+            ret.madd(kd, intensity, std::max(0.0, normal.dot(l)));
+            ret.madd(ks, intensity, std::pow(std::max(0.0, normal.dot(h)), p));
         }
         return ret;
     }
@@ -0,0 +1,82 @@
+#ifndef ANYA_RENDERER_ALIAS_TABLE_HPP
+#define ANYA_RENDERER_ALIAS_TABLE_HPP
+
+#include "tool/vec.hpp"
+#include <vector>
+
+namespace anya {
+
+// 别名表: 按非负权重的离散分布采样，构建 O(n)，采样 O(1)
+// 见 Vose, "A Linear Algorithm for Generating Random Numbers with a Given Distribution"
+class AliasTable {
+private:
+    struct Bin {
+        numberType q = 0.0;     // 选中本桶自身的概率阈值
+        int alias = 0;          // 未选中自身时改选的下标
+        numberType pmf = 0.0;   // 本下标的概率
+    };
+
+    std::vector<Bin> bins;
+    numberType total = 0.0;     // 权重之和
+
+public:
+    AliasTable() = default;
+
+    explicit AliasTable(const std::vector<numberType>& weights) {
+        int n = static_cast<int>(weights.size());
+        for (auto w : weights) total += w;
+        if (n == 0 || !(total > 0.0)) {
+            total = 0.0;
+            return;
+        }
+
+        bins.resize(n);
+        // 把每个概率放大n倍，小于1的桶由大于1的桶补齐
+        std::vector<numberType> scaled(n);
+        std::vector<int> small, large;
+        for (int i = 0; i < n; ++i) {
+            bins[i].pmf = weights[i] / total;
+            scaled[i] = bins[i].pmf * n;
+            (scaled[i] < 1.0 ? small : large).push_back(i);
+        }
+        while (!small.empty() && !large.empty()) {
+            int s = small.back(); small.pop_back();
+            int l = large.back(); large.pop_back();
+            bins[s].q = scaled[s];
+            bins[s].alias = l;
+            scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+            (scaled[l] < 1.0 ? small : large).push_back(l);
+        }
+        // 剩下的桶只受舍入误差影响，概率视为1
+        for (int i : large) bins[i] = { 1.0, i, bins[i].pmf };
+        for (int i : small) bins[i] = { 1.0, i, bins[i].pmf };
+    }
+
+public:
+    // 用一个 [0, 1) 的随机数采样，整数部分选桶，小数部分决定取桶自身还是别名
+    [[nodiscard]] int
+    sample(numberType u) const {
+        int n = static_cast<int>(bins.size());
+        numberType scaled = u * n;
+        int i = std::min(static_cast<int>(scaled), n - 1);
+        return scaled - i < bins[i].q ? i : bins[i].alias;
+    }
+
+    // 第i个下标被选中的概率
+    [[nodiscard]] numberType
+    pmf(int i) const { return bins[i].pmf; }
+
+    // 权重之和
+    [[nodiscard]] numberType
+    sum() const noexcept { return total; }
+
+    [[nodiscard]] int
+    size() const noexcept { return static_cast<int>(bins.size()); }
+
+    [[nodiscard]] bool
+    empty() const noexcept { return bins.empty(); }
+};
+
+}
+
+#endif //ANYA_RENDERER_ALIAS_TABLE_HPP
@@ -0,0 +1,135 @@
+#ifndef ANYA_RENDERER_HEATMAP_HPP
+#define ANYA_RENDERER_HEATMAP_HPP
+
+#include "load/texture.hpp"
+#include "tool/stats.hpp"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace anya {
+
+// 代价热力图的度量
+enum class CostMetric {
+    NONE,           // 不生成热力图
+    TIME,           // 像素上花费的纳秒数
+    NODES,          // BVH节点访问数，仅光线追踪
+    PRIMITIVES,     // 光线追踪: 三角形与球的求交测试数; 光栅化: 包围盒覆盖该像素的三角形数
+    FRAGMENTS       // 着色的片元数(每像素4个采样点)，即overdraw，仅光栅化
+};
+
+// 逐像素的代价缓冲，渲染结束后按伪彩色色带映射为图片，便于找出代价集中的区域
+// 下标与输出图片的坐标一致，渲染时每个像素只由一个线程写入
+class CostHeatmap {
+public:
+    static constexpr double percentile = 0.99;  // 以该分位数作为色带的上限，避免少数极端像素压暗整张图
+
+private:
+    CostMetric metric = CostMetric::NONE;
+    int width = 0, height = 0;
+    std::vector<double> cost;
+
+public:
+    void
+    reset(CostMetric m, int w, int h) {
+        metric = m;
+        width = w;
+        height = h;
+        cost.assign(metric == CostMetric::NONE ? 0 : static_cast<std::size_t>(w) * h, 0.0);
+    }
+
+    [[nodiscard]] bool
+    enabled() const noexcept { return metric != CostMetric::NONE; }
+
+    [[nodiscard]] CostMetric
+    getMetric() const noexcept { return metric; }
+
+    void
+    add(int x, int y, double value) {
+        cost[static_cast<std::size_t>(y) * width + x] += value;
+    }
+
+    // 当前线程到目前为止的累计代价，两次读数之差即为其间的代价
+    [[nodiscard]] double
+    probe() const {
+        switch (metric) {
+            case CostMetric::NODES:
+                return double(RenderStats::local().nodesVisited);
+            case CostMetric::PRIMITIVES:
+                return double(RenderStats::local().triangleTests + RenderStats::local().sphereTests);
+            default:
+                return double(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+        }
+    }
+
+    // 色带的上限: 非零代价的percentile分位数
+    [[nodiscard]] double
+    scale() const {
+        std::vector<double> values;
+        values.reserve(cost.size());
+        for (double v : cost) if (v > 0) values.push_back(v);
+        if (values.empty()) return 1.0;
+        auto nth = values.begin() + static_cast<long long>(double(values.size() - 1) * percentile);
+        std::nth_element(values.begin(), nth, values.end());
+        return *nth;
+    }
+
+    [[nodiscard]] double
+    max() const {
+        return cost.empty() ? 0.0 : *std::max_element(cost.begin(), cost.end());
+    }
+
+    // 代价线性映射到 [0, scale()]，超出的像素取色带的最高色
+    [[nodiscard]] std::shared_ptr<Texture>
+    toImage() const {
+        auto image = std::make_shared<Texture>(width, height, ramp(0));
+        double inv = 1.0 / scale();
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                image->setPixel(x, y, ramp(cost[static_cast<std::size_t>(y) * width + x] * inv));
+            }
+        }
+        return image;
+    }
+
+    // jet色带: 深蓝 -> 蓝 -> 青 -> 黄 -> 红 -> 暗红
+    [[nodiscard]] static Vector3
+    ramp(double t) {
+        static const Vector3 stops[] = {
+            { 0.0, 0.0, 0.5 }, { 0.0, 0.0, 1.0 }, { 0.0, 1.0, 1.0 }, { 1.0, 1.0, 0.0 }, { 1.0, 0.0, 0.0 }, { 0.5, 0.0, 0.0 }
+        };
+        static const double keys[] = { 0.0, 0.125, 0.375, 0.625, 0.875, 1.0 };
+        t = std::clamp(t, 0.0, 1.0);
+        int i = 1;
+        while (i < 5 && t > keys[i]) ++i;
+        return MathUtils::lerp((t - keys[i - 1]) / (keys[i] - keys[i - 1]), stops[i - 1], stops[i]);
+    }
+
+public:
+    [[nodiscard]] static CostMetric
+    toMetric(const std::string& name) {
+        if (name == "none") return CostMetric::NONE;
+        if (name == "time") return CostMetric::TIME;
+        if (name == "nodes") return CostMetric::NODES;
+        if (name == "primitives") return CostMetric::PRIMITIVES;
+        if (name == "fragments") return CostMetric::FRAGMENTS;
+        throw std::invalid_argument("unknown heatmap metric " + name);
+    }
+
+    [[nodiscard]] static const char*
+    name(CostMetric m) {
+        switch (m) {
+            case CostMetric::TIME: return "time";
+            case CostMetric::NODES: return "nodes";
+            case CostMetric::PRIMITIVES: return "primitives";
+            case CostMetric::FRAGMENTS: return "fragments";
+            default: return "none";
+        }
+    }
+};
+
+}
+
+#endif //ANYA_RENDERER_HEATMAP_HPP
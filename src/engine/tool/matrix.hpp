@@ -6,15 +6,23 @@
 #define ANYA_ENGINE_MATRIX_HPP
 
 #include "vec.hpp"
+#include "simd.hpp"
+#include <array>
 #include <exception>
+#include <stdexcept>
+#include <type_traits>
 
 namespace anya {
 
-template<int M, int N> requires(M >= 1 && N >= 1)
+// M行N列矩阵，T为元素类型，默认为numberType(双精度)
+template<int M, int N, class T = numberType> requires(M >= 1 && N >= 1)
 class Matrix {
 private:
     // 底层数据存储, 列向量形式存储
-    Vector<M> data[N];
+    Vector<M, T> data[N];
+
+    // 4*4双精度矩阵的乘法走SIMD内核，每一列正好是一个Double4
+    static constexpr bool simd44 = M == 4 && N == 4 && std::is_same_v<T, numberType>;
 
 private:
 #pragma region 辅助类
@@ -23,7 +31,7 @@ private:
 
         // 重载逗号运算发实现链式调用 eg: mat << 1, 2, 3;
         constexpr Loader
-        operator,(numberType val) {
+        operator,(T val) {
             // 多余的数据会被直接忽略掉
             if (cnt / N >= M) return Loader(mat, cnt + 1);
             mat(cnt / N, cnt % N) = val;
@@ -40,7 +48,7 @@ public:
 
     // 实现逗号初始化 eg: mat << 1, 2, 3;
     constexpr Loader
-    operator<<(numberType val) {
+    operator<<(T val) {
         data[0][0] = val;
         return Loader(*this, 1);
     }
@@ -55,17 +63,16 @@ public:
 
 public:
 #pragma region 访问
-    constexpr numberType&
+    // 只在调试构建(未定义NDEBUG)中进行越界检查
+    constexpr T&
     operator()(int i, int j) {
-        if (out_range(i, j))
-            throw std::out_of_range("Matrix::operator()");
+        check(i, j);
         return data[j][i];
     }
 
-    constexpr const numberType&
+    constexpr const T&
     operator()(int i, int j) const {
-        if (out_range(i, j))
-            throw std::out_of_range("Matrix::operator()");
+        check(i, j);
         return data[j][i];
     }
 
@@ -78,17 +85,17 @@ public:
     columns() const noexcept { return N; }
 
     // 返回第 rows 行的行向量
-    [[nodiscard]] constexpr Vector<N>
+    [[nodiscard]] constexpr Vector<N, T>
     rowVec(int row) const {
         if (out_range(row, 0))
             throw std::out_of_range("Matrix::rowVec");
-        Vector<N> ret{};
+        Vector<N, T> ret{};
         for (int j = 0; j < N; ++j) ret[j] = (*this)(row, j);
         return ret;
     }
 
     // 返回第 col 列的列向量
-    [[nodiscard]] constexpr Vector<M>
+    [[nodiscard]] constexpr Vector<M, T>
     colVec(int col) const {
         if (out_range(0, col))
             throw std::out_of_range("Matrix::rowVec");
@@ -97,7 +104,7 @@ public:
 
     // 设置第 col 列的列向量
     constexpr void
-    setColVec(int col, const Vector<M>& vec) {
+    setColVec(int col, const Vector<M, T>& vec) {
         if (out_range(0, col))
             throw std::out_of_range("Matrix::rowVec");
         data[col] = vec;
@@ -105,7 +112,7 @@ public:
 
     // 设置第 row 行的行向量
     constexpr void
-    setRowVec(int row, const Vector<N>& vec) {
+    setRowVec(int row, const Vector<N, T>& vec) {
         if (out_range(row, 0))
             throw std::out_of_range("Matrix::rowVec");
         for (int j = 0; j < N; ++j) (*this)(row, j) = vec[j];
@@ -115,8 +122,8 @@ public:
 public:
 #pragma region 矩阵运算
     // 转置
-    [[nodiscard]] constexpr Matrix<N, M> transpose() const {
-        Matrix<N, M> ret{};
+    [[nodiscard]] constexpr Matrix<N, M, T> transpose() const {
+        Matrix<N, M, T> ret{};
         for (int i = 0; i < M; ++i) {
             for (int j = 0; j < N; ++j) {
                 ret(j, i) = (*this)(i, j);
@@ -125,14 +132,24 @@ public:
         return ret;
     }
 
-    // 行列式
-    [[nodiscard]] constexpr numberType
+    // 行列式，3阶和4阶使用展开后的闭式
+    [[nodiscard]] constexpr T
     det() const requires(M == N) {
         if constexpr (M == 1) {
             return (*this)(0, 0);
         }
+        else if constexpr (M == 3) {
+            const auto& m = *this;
+            return m(0, 0) * (m(1, 1) * m(2, 2) - m(1, 2) * m(2, 1))
+                 - m(0, 1) * (m(1, 0) * m(2, 2) - m(1, 2) * m(2, 0))
+                 + m(0, 2) * (m(1, 0) * m(2, 1) - m(1, 1) * m(2, 0));
+        }
+        else if constexpr (M == 4) {
+            auto [s, c] = subDet2x2();
+            return s[0] * c[5] - s[1] * c[4] + s[2] * c[3] + s[3] * c[2] - s[4] * c[1] + s[5] * c[0];
+        }
         else {
-            numberType ans = 0;
+            T ans = 0;
             for (int i = 0; i < M; ++i) {
                 ans += (*this)(0, i) * minor_det(0, i);
             }
@@ -140,28 +157,36 @@ public:
         }
     }
 
-    // 求逆
-    [[nodiscard]] constexpr Matrix<M, N>
+    // 求逆，3阶和4阶使用闭式的伴随矩阵，其余维数使用代数余子式展开
+    [[nodiscard]] constexpr Matrix<M, N, T>
     inverse() const requires(M == N) {
-        numberType det = this->det();
-        if (det == 0.0) {
-            std::cerr << "The determinant is zero, this matrix has no inverse!" << std::endl;
-            return {};
+        if constexpr (M == 3) {
+            return inverse33();
         }
-        Matrix<M, N> ret{};
-        for (int i = 0; i < M; ++i) {
-            for (int j = 0; j < N; ++j) {
-                ret(i, j) = minor_det(i, j);
+        else if constexpr (M == 4) {
+            return inverse44();
+        }
+        else {
+            T det = this->det();
+            if (det == 0.0) {
+                std::cerr << "The determinant is zero, this matrix has no inverse!" << std::endl;
+                return {};
+            }
+            Matrix<M, N, T> ret{};
+            for (int i = 0; i < M; ++i) {
+                for (int j = 0; j < N; ++j) {
+                    ret(i, j) = minor_det(i, j);
+                }
             }
+            ret /= det;
+            return ret.transpose();
         }
-        ret /= det;
-        return ret.transpose();
     }
 
     // 转换为其他维数的矩阵
     template<int Q, int W>
-    constexpr Matrix<Q, W> to(numberType fill = 0.0) const {
-        Matrix<Q, W> ret{};
+    constexpr Matrix<Q, W, T> to(T fill = 0.0) const {
+        Matrix<Q, W, T> ret{};
         for (int i = 0; i < Q; ++i) {
             for (int j = 0; j < W; ++j) {
                 ret(i, j) = out_range(i, j) ? fill : (*this)(i, j);
@@ -171,9 +196,9 @@ public:
     }
 
     // 从3*3矩阵转变为齐次坐标下的4*4矩阵
-    [[nodiscard]] constexpr Matrix<4, 4>
+    [[nodiscard]] constexpr Matrix<4, 4, T>
     to44() const requires(M == 3 && N == 3) {
-        Matrix<4, 4> ret = to<4, 4>();
+        Matrix<4, 4, T> ret = to<4, 4>();
         ret(3, 3) = 1;
         return ret;
     }
@@ -181,33 +206,60 @@ public:
 
 public:
 #pragma region 矩阵运算涉及的运算符重载
-    // 矩阵 * 矩阵
+    // 矩阵 * 矩阵，结果的第j列即lhs * rhs的第j列
     template<int C>
-    constexpr friend Matrix<M, C>
-    operator*(const Matrix<M, N>& lhs, const Matrix<N, C>& rhs) noexcept {
-        Matrix<M, C> ret{};
-        for (int i = 0; i < M; ++i) {
-            for (int j = 0; j < C; ++j) {
-                for (int k = 0; k < N; ++k) {
-                    ret(i, j) += lhs(i, k) * rhs(k, j);
-                }
-            }
+    constexpr friend Matrix<M, C, T>
+    operator*(const Matrix<M, N, T>& lhs, const Matrix<N, C, T>& rhs) noexcept {
+        Matrix<M, C, T> ret{};
+        for (int j = 0; j < C; ++j) {
+            ret.setColVec(j, lhs * rhs.colVec(j));
         }
         return ret;
     }
 
     // 列向量左乘矩阵
-    constexpr friend Vector<M>
-    operator*(const Matrix<M, N>& lhs, const Vector<N>& rhs) noexcept {
-        Vector<M> ret{};
-        for (int i = 0; i < M; ++i) ret[i] = lhs.rowVec(i).dot(rhs);
+    constexpr friend Vector<M, T>
+    operator*(const Matrix<M, N, T>& lhs, const Vector<N, T>& rhs) noexcept {
+        Vector<M, T> ret{};
+        if constexpr (simd44) {
+            if (!std::is_constant_evaluated()) {
+                lhs.mulVec(lhs.loadColumns(), &rhs[0], &ret[0]);
+                return ret;
+            }
+        }
+        for (int k = 0; k < N; ++k) {
+            for (int i = 0; i < M; ++i) {
+                ret[i] += lhs.data[k][i] * rhs[k];
+            }
+        }
         return ret;
     }
 
+    // 批量变换: 用同一个矩阵变换count个列向量，in与out可以是同一个数组
+    // 4*4双精度矩阵只读取一次列向量，之后每个向量只需4次广播、4次乘法与4次加法
+    void
+    transform(const Vector<N, T>* in, Vector<M, T>* out, std::size_t count) const {
+        if constexpr (simd44) {
+            auto cols = loadColumns();
+            for (std::size_t n = 0; n < count; ++n) mulVec(cols, &in[n][0], &out[n][0]);
+        }
+        else {
+            for (std::size_t n = 0; n < count; ++n) out[n] = (*this) * in[n];
+        }
+    }
+
+    // 批量变换三维点，按齐次坐标w = 1变换后取前三个分量，不做透视除法
+    void
+    transformPoints(const Vector<3, T>* in, Vector<3, T>* out, std::size_t count) const requires(M == 4 && N == 4) {
+        for (std::size_t n = 0; n < count; ++n) {
+            out[n] = ((*this) * in[n].to4()).template to<3>();
+        }
+    }
+
     // 列向量右乘矩阵，相当于列向量和行向量相乘得到 N * N 的矩阵
-    constexpr friend Matrix<N, N>
-    operator*(const Vector<N>& lhs, const Matrix<M, N>& rhs) noexcept requires(M == 1) {
-        Matrix<N, N> ret{};
+    constexpr friend Matrix<N, N, T>
+    operator*(const Vector<N, T>& lhs, const Matrix<M, N, T>& rhs) noexcept requires(M == 1) {
+        Matrix<N, N, T> ret{};
         for (int i = 0; i < N; ++i) ret.setColVec(i, rhs(0, i) * lhs);
         return ret;
     }
@@ -232,7 +284,7 @@ public:
 
     // 矩阵乘k
     constexpr Matrix&
-    operator*=(numberType k) noexcept {
+    operator*=(T k) noexcept {
         for (int i = 0; i < N; ++i) {
             data[i] *= k;
         }
@@ -241,7 +293,7 @@ public:
 
     // 矩阵除k
     constexpr Matrix&
-    operator/=(numberType k) {
+    operator/=(T k) {
         for (int i = 0; i < N; ++i) {
             data[i] /= k;
         }
@@ -255,13 +307,13 @@ public:
     operator-(const Matrix& lhs, const Matrix& rhs) noexcept { return Matrix{lhs} -= rhs; }
 
     constexpr friend Matrix
-    operator*(const Matrix& lhs, numberType k) noexcept { return Matrix{lhs} *= k; }
+    operator*(const Matrix& lhs, T k) noexcept { return Matrix{lhs} *= k; }
 
     constexpr friend Matrix
-    operator*(numberType k, const Matrix& rhs) noexcept { return Matrix{rhs} *= k; }
+    operator*(T k, const Matrix& rhs) noexcept { return Matrix{rhs} *= k; }
 
     constexpr friend Matrix
-    operator/(const Matrix& lhs, numberType k) { return Matrix{lhs} /= k; }
+    operator/(const Matrix& lhs, T k) { return Matrix{lhs} /= k; }
 
 #pragma endregion
 
@@ -286,10 +338,18 @@ public:
         return i < 0 || i >= M || j < 0 || j >= N;
     }
 
+    constexpr static void
+    check([[maybe_unused]] int i, [[maybe_unused]] int j) {
+#ifndef NDEBUG
+        if (out_range(i, j))
+            throw std::out_of_range("Matrix::operator()");
+#endif
+    }
+
     // matrix去掉x行和y列后得到的余子式
     [[nodiscard]] constexpr auto
     minor(int x, int y) const requires(M == N) {
-        Matrix<M - 1, N - 1> ret{};
+        Matrix<M - 1, N - 1, T> ret{};
         for (int i = 0, row = 0; i < M; ++i) {
             if (i == x) continue ;
             for (int j = 0, column = 0; j < N; ++j) {
@@ -303,10 +363,107 @@ public:
     }
 
     // 代数余子式的值
-    [[nodiscard]] constexpr numberType
+    [[nodiscard]] constexpr T
     minor_det(int x, int y) const requires(M == N) {
         return minor(x, y).det() * ((x + y) % 2 ? -1 : 1);
     }
+
+private:
+    // 一次读入4*4矩阵的4个列向量
+    [[nodiscard]] std::array<Double4, 4>
+    loadColumns() const requires(simd44) {
+        return { Double4::loadu(&data[0][0]), Double4::loadu(&data[1][0]),
+                 Double4::loadu(&data[2][0]), Double4::loadu(&data[3][0]) };
+    }
+
+    // ret = sum(col_k * v_k)，每个分量的累加顺序与标量实现一致，结果逐位相同
+    static void
+    mulVec(const std::array<Double4, 4>& cols, const T* v, T* ret) requires(simd44) {
+        Double4 acc(0.0);
+        acc = acc + cols[0] * Double4(v[0]);
+        acc = acc + cols[1] * Double4(v[1]);
+        acc = acc + cols[2] * Double4(v[2]);
+        acc = acc + cols[3] * Double4(v[3]);
+        acc.storeu(ret);
+    }
+
+    // 4阶矩阵上两行与下两行的6个2阶子式，行列式与伴随矩阵都由它们组合得到
+    [[nodiscard]] constexpr std::pair<std::array<T, 6>, std::array<T, 6>>
+    subDet2x2() const requires(M == 4 && N == 4) {
+        const auto& m = *this;
+        std::array<T, 6> s = {
+            m(0, 0) * m(1, 1) - m(1, 0) * m(0, 1),
+            m(0, 0) * m(1, 2) - m(1, 0) * m(0, 2),
+            m(0, 0) * m(1, 3) - m(1, 0) * m(0, 3),
+            m(0, 1) * m(1, 2) - m(1, 1) * m(0, 2),
+            m(0, 1) * m(1, 3) - m(1, 1) * m(0, 3),
+            m(0, 2) * m(1, 3) - m(1, 2) * m(0, 3)
+        };
+        std::array<T, 6> c = {
+            m(2, 0) * m(3, 1) - m(3, 0) * m(2, 1),
+            m(2, 0) * m(3, 2) - m(3, 0) * m(2, 2),
+            m(2, 0) * m(3, 3) - m(3, 0) * m(2, 3),
+            m(2, 1) * m(3, 2) - m(3, 1) * m(2, 2),
+            m(2, 1) * m(3, 3) - m(3, 1) * m(2, 3),
+            m(2, 2) * m(3, 3) - m(3, 2) * m(2, 3)
+        };
+        return { s, c };
+    }
+
+    [[nodiscard]] constexpr Matrix
+    inverse33() const requires(M == 3 && N == 3) {
+        T det = this->det();
+        if (det == 0.0) {
+            std::cerr << "The determinant is zero, this matrix has no inverse!" << std::endl;
+            return {};
+        }
+        const auto& m = *this;
+        T k = 1 / det;
+        Matrix ret{};
+        ret(0, 0) = (m(1, 1) * m(2, 2) - m(1, 2) * m(2, 1)) * k;
+        ret(0, 1) = (m(0, 2) * m(2, 1) - m(0, 1) * m(2, 2)) * k;
+        ret(0, 2) = (m(0, 1) * m(1, 2) - m(0, 2) * m(1, 1)) * k;
+        ret(1, 0) = (m(1, 2) * m(2, 0) - m(1, 0) * m(2, 2)) * k;
+        ret(1, 1) = (m(0, 0) * m(2, 2) - m(0, 2) * m(2, 0)) * k;
+        ret(1, 2) = (m(0, 2) * m(1, 0) - m(0, 0) * m(1, 2)) * k;
+        ret(2, 0) = (m(1, 0) * m(2, 1) - m(1, 1) * m(2, 0)) * k;
+        ret(2, 1) = (m(0, 1) * m(2, 0) - m(0, 0) * m(2, 1)) * k;
+        ret(2, 2) = (m(0, 0) * m(1, 1) - m(0, 1) * m(1, 0)) * k;
+        return ret;
+    }
+
+    [[nodiscard]] constexpr Matrix
+    inverse44() const requires(M == 4 && N == 4) {
+        auto [s, c] = subDet2x2();
+        T det = s[0] * c[5] - s[1] * c[4] + s[2] * c[3] + s[3] * c[2] - s[4] * c[1] + s[5] * c[0];
+        if (det == 0.0) {
+            std::cerr << "The determinant is zero, this matrix has no inverse!" << std::endl;
+            return {};
+        }
+        const auto& m = *this;
+        T k = 1 / det;
+        Matrix ret{};
+        ret(0, 0) = ( m(1, 1) * c[5] - m(1, 2) * c[4] + m(1, 3) * c[3]) * k;
+        ret(0, 1) = (-m(0, 1) * c[5] + m(0, 2) * c[4] - m(0, 3) * c[3]) * k;
+        ret(0, 2) = ( m(3, 1) * s[5] - m(3, 2) * s[4] + m(3, 3) * s[3]) * k;
+        ret(0, 3) = (-m(2, 1) * s[5] + m(2, 2) * s[4] - m(2, 3) * s[3]) * k;
+
+        ret(1, 0) = (-m(1, 0) * c[5] + m(1, 2) * c[2] - m(1, 3) * c[1]) * k;
+        ret(1, 1) = ( m(0, 0) * c[5] - m(0, 2) * c[2] + m(0, 3) * c[1]) * k;
+        ret(1, 2) = (-m(3, 0) * s[5] + m(3, 2) * s[2] - m(3, 3) * s[1]) * k;
+        ret(1, 3) = ( m(2, 0) * s[5] - m(2, 2) * s[2] + m(2, 3) * s[1]) * k;
+
+        ret(2, 0) = ( m(1, 0) * c[4] - m(1, 1) * c[2] + m(1, 3) * c[0]) * k;
+        ret(2, 1) = (-m(0, 0) * c[4] + m(0, 1) * c[2] - m(0, 3) * c[0]) * k;
+        ret(2, 2) = ( m(3, 0) * s[4] - m(3, 1) * s[2] + m(3, 3) * s[0]) * k;
+        ret(2, 3) = (-m(2, 0) * s[4] + m(2, 1) * s[2] - m(2, 3) * s[0]) * k;
+
+        ret(3, 0) = (-m(1, 0) * c[3] + m(1, 1) * c[1] - m(1, 2) * c[0]) * k;
+        ret(3, 1) = ( m(0, 0) * c[3] - m(0, 1) * c[1] + m(0, 2) * c[0]) * k;
+        ret(3, 2) = (-m(3, 0) * s[3] + m(3, 1) * s[1] - m(3, 2) * s[0]) * k;
+        ret(3, 3) = ( m(2, 0) * s[3] - m(2, 1) * s[1] + m(2, 2) * s[0]) * k;
+        return ret;
+    }
 #pragma endregion
 };
 
@@ -317,6 +474,9 @@ using Matrix43 = Matrix<4, 3>;
 using Matrix44 = Matrix<4, 4>;
 using RowVector3 = Matrix<1, 3>;
 using RowVector4 = Matrix<1, 4>;
+// 单精度矩阵
+using Matrix33f = Matrix<3, 3, float>;
+using Matrix44f = Matrix<4, 4, float>;
 
 }
 
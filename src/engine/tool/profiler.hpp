@@ -0,0 +1,157 @@
+#ifndef ANYA_RENDERER_PROFILER_HPP
+#define ANYA_RENDERER_PROFILER_HPP
+
+#include "nlohmann/json.hpp"
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace anya {
+
+// 性能剖析开关，编译时定义ANYA_NO_PROFILER可去掉所有剖析区间
+#ifdef ANYA_NO_PROFILER
+inline constexpr bool profilerEnabled = false;
+#else
+inline constexpr bool profilerEnabled = true;
+#endif
+
+// 剖析器: 记录各线程上带名字的时间区间，导出为Chrome trace格式的JSON，可在Perfetto或chrome://tracing中查看整个渲染的时间线
+// 每个线程把区间追加到自己的缓冲中，记录时不加锁；未调用start()时ProfileScope只读一次原子标志，不取时间也不写入数据
+class Profiler {
+public:
+    // 一个时间区间，时间为相对start()的纳秒数
+    struct Event {
+        const char* name;
+        const char* category;
+        long long begin;
+        long long duration;
+        std::string detail;     // 附加说明，如加载的文件路径，可为空
+    };
+
+private:
+    struct ThreadBuffer {
+        int tid = 0;
+        std::vector<Event> events;
+    };
+
+    static inline std::atomic<bool> active{ false };
+    static inline std::mutex mutex;
+    static inline std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    static inline std::chrono::steady_clock::time_point origin{};
+
+public:
+    // 清空之前的记录并开始记录，调用start()的线程在时间线中显示为main
+    static void
+    start() {
+        if constexpr (!profilerEnabled) return;
+        {
+            std::lock_guard guard(mutex);
+            for (auto& buffer : buffers) buffer->events.clear();
+            origin = std::chrono::steady_clock::now();
+        }
+        local();
+        active.store(true, std::memory_order_release);
+    }
+
+    static void
+    stop() {
+        active.store(false, std::memory_order_release);
+    }
+
+    [[nodiscard]] static bool
+    isActive() {
+        return profilerEnabled && active.load(std::memory_order_relaxed);
+    }
+
+    // 相对start()的纳秒数
+    [[nodiscard]] static long long
+    now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+    }
+
+    static void
+    record(const char* name, const char* category, long long begin, long long end, std::string detail = {}) {
+        local().events.push_back({ name, category, begin, end - begin, std::move(detail) });
+    }
+
+    // 导出为Chrome trace格式，应在stop()之后、没有线程仍在记录时调用
+    [[nodiscard]] static nlohmann::json
+    toChromeTrace() {
+        std::lock_guard guard(mutex);
+        nlohmann::json events = nlohmann::json::array();
+        for (const auto& buffer : buffers) {
+            events.push_back({
+                { "name", "thread_name" }, { "ph", "M" }, { "pid", 1 }, { "tid", buffer->tid },
+                { "args", { { "name", buffer->tid == 0 ? std::string("main") : "worker " + std::to_string(buffer->tid) } } }
+            });
+            for (const auto& event : buffer->events) {
+                nlohmann::json item = {
+                    { "name", event.name }, { "cat", event.category }, { "ph", "X" },
+                    { "ts", event.begin * 1e-3 }, { "dur", event.duration * 1e-3 },
+                    { "pid", 1 }, { "tid", buffer->tid }
+                };
+                if (!event.detail.empty()) item["args"] = { { "detail", event.detail } };
+                events.push_back(std::move(item));
+            }
+        }
+        return { { "traceEvents", events }, { "displayTimeUnit", "ms" } };
+    }
+
+    // 写入成功时返回true
+    static bool
+    writeChromeTrace(const std::string& path) {
+        std::ofstream ofs(path);
+        ofs << toChromeTrace().dump() << std::endl;
+        return static_cast<bool>(ofs);
+    }
+
+private:
+    // 当前线程的缓冲，第一次使用时按顺序分配线程编号并登记，线程退出后缓冲仍由buffers持有
+    static ThreadBuffer&
+    local() {
+        thread_local std::shared_ptr<ThreadBuffer> buffer = [] {
+            std::lock_guard guard(mutex);
+            auto ret = std::make_shared<ThreadBuffer>();
+            ret->tid = static_cast<int>(buffers.size());
+            buffers.push_back(ret);
+            return ret;
+        }();
+        return *buffer;
+    }
+};
+
+// 剖析区间，构造时开始计时，析构时把区间记录到当前线程，名字与类别须为字符串常量
+class ProfileScope {
+private:
+    const char* name;
+    const char* category;
+    long long begin = -1;
+    std::string detail;
+
+public:
+    explicit ProfileScope(const char* n, const char* c = "anya"): name(n), category(c) {
+        if (Profiler::isActive()) begin = Profiler::now();
+    }
+
+    ProfileScope(const char* n, const char* c, const std::string& d): name(n), category(c) {
+        if (Profiler::isActive()) {
+            detail = d;
+            begin = Profiler::now();
+        }
+    }
+
+    ~ProfileScope() {
+        if (begin >= 0) Profiler::record(name, category, begin, Profiler::now(), std::move(detail));
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+};
+
+}
+
+#endif //ANYA_RENDERER_PROFILER_HPP
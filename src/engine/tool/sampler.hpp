@@ -0,0 +1,64 @@
+#ifndef ANYA_RENDERER_SAMPLER_HPP
+#define ANYA_RENDERER_SAMPLER_HPP
+
+#include "tool/vec.hpp"
+#include <cstdint>
+
+namespace anya {
+
+// 基于计数器的随机数采样器
+// 以 (像素, 样本序号, 维度, 种子) 为键，经PCG哈希直接得到随机数，不持有任何共享状态
+// 每个样本在栈上构造自己的采样器，因此多线程下没有竞争，且结果与线程数、调度顺序无关
+class Sampler {
+private:
+    std::uint32_t pixel = 0;      // 像素下标
+    std::uint32_t index = 0;      // 样本序号
+    std::uint32_t seed = 0;       // 全局种子
+    std::uint32_t dimension = 0;  // 当前消耗到的维度
+
+public:
+    Sampler() = default;
+
+    Sampler(std::uint32_t pixel, std::uint32_t index, std::uint32_t seed = 0)
+        : pixel(pixel), index(index), seed(seed)
+    {}
+
+public:
+    // 返回下一个维度上 [0, 1) 的均匀随机数
+    [[nodiscard]] numberType
+    get1D() {
+        return toUnit(hash(pixel, index, dimension++, seed));
+    }
+
+    // 返回下两个维度上 [0, 1)^2 的均匀随机数
+    [[nodiscard]] Vector2
+    get2D() {
+        numberType x = get1D();
+        numberType y = get1D();
+        return { x, y };
+    }
+
+private:
+    // PCG哈希，见 Jarzynski & Olano, "Hash Functions for GPU Rendering"
+    static constexpr std::uint32_t
+    pcg(std::uint32_t v) {
+        std::uint32_t state = v * 747796405u + 2891336453u;
+        std::uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+        return (word >> 22u) ^ word;
+    }
+
+    static constexpr std::uint32_t
+    hash(std::uint32_t a, std::uint32_t b, std::uint32_t c, std::uint32_t d) {
+        return pcg(d + pcg(c + pcg(b + pcg(a))));
+    }
+
+    // 将32位整数映射到 [0, 1)
+    static constexpr numberType
+    toUnit(std::uint32_t v) {
+        return static_cast<numberType>(v) * (1.0 / 4294967296.0);
+    }
+};
+
+}
+
+#endif //ANYA_RENDERER_SAMPLER_HPP
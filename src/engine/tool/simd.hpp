@@ -0,0 +1,153 @@
+#ifndef ANYA_RENDERER_SIMD_HPP
+#define ANYA_RENDERER_SIMD_HPP
+
+#include "tool/vec.hpp"
+#include <algorithm>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+namespace anya {
+
+// 4个双精度数组成的SIMD向量，光线包中每个通道对应一条光线
+// 编译器开启AVX(-mavx2 或 /arch:AVX2)时用__m256d实现，否则退化为逐通道的标量循环，结果与标量代码逐位一致
+// 比较运算返回4位的通道掩码，第i位对应第i个通道
+class Double4 {
+private:
+#if defined(__AVX__)
+    __m256d v;
+    explicit Double4(__m256d x): v(x) {}
+#else
+    numberType v[4];
+#endif
+
+public:
+    Double4() = default;
+
+    explicit Double4(numberType x) {
+#if defined(__AVX__)
+        v = _mm256_set1_pd(x);
+#else
+        for (auto& i : v) i = x;
+#endif
+    }
+
+    // 从32字节对齐的数组读取
+    static Double4
+    load(const numberType* p) {
+#if defined(__AVX__)
+        return Double4(_mm256_load_pd(p));
+#else
+        Double4 ret;
+        for (int i = 0; i < 4; ++i) ret.v[i] = p[i];
+        return ret;
+#endif
+    }
+
+    // 从16字节对齐的单精度数组读取并转换为双精度，用于BVH节点中单精度存放的包围盒
+    static Double4
+    load(const float* p) {
+#if defined(__AVX__)
+        return Double4(_mm256_cvtps_pd(_mm_load_ps(p)));
+#else
+        Double4 ret;
+        for (int i = 0; i < 4; ++i) ret.v[i] = p[i];
+        return ret;
+#endif
+    }
+
+    // 从不保证对齐的数组读取，用于矩阵的列向量等
+    static Double4
+    loadu(const numberType* p) {
+#if defined(__AVX__)
+        return Double4(_mm256_loadu_pd(p));
+#else
+        return load(p);
+#endif
+    }
+
+    // 写回32字节对齐的数组
+    void
+    store(numberType* p) const {
+#if defined(__AVX__)
+        _mm256_store_pd(p, v);
+#else
+        for (int i = 0; i < 4; ++i) p[i] = v[i];
+#endif
+    }
+
+    // 写回不保证对齐的数组
+    void
+    storeu(numberType* p) const {
+#if defined(__AVX__)
+        _mm256_storeu_pd(p, v);
+#else
+        store(p);
+#endif
+    }
+
+public:
+#pragma region 运算符
+#if defined(__AVX__)
+    friend Double4 operator+(Double4 a, Double4 b) { return Double4(_mm256_add_pd(a.v, b.v)); }
+    friend Double4 operator-(Double4 a, Double4 b) { return Double4(_mm256_sub_pd(a.v, b.v)); }
+    friend Double4 operator*(Double4 a, Double4 b) { return Double4(_mm256_mul_pd(a.v, b.v)); }
+    friend Double4 operator/(Double4 a, Double4 b) { return Double4(_mm256_div_pd(a.v, b.v)); }
+
+    // 与std::max(a, b), std::min(a, b)的语义一致，任一参数为NaN时返回a
+    friend Double4 max(Double4 a, Double4 b) { return Double4(_mm256_max_pd(b.v, a.v)); }
+    friend Double4 min(Double4 a, Double4 b) { return Double4(_mm256_min_pd(b.v, a.v)); }
+
+    // sign通道的符号位为1时取b，否则取a
+    friend Double4 selectBySign(Double4 sign, Double4 a, Double4 b) { return Double4(_mm256_blendv_pd(a.v, b.v, sign.v)); }
+
+    friend int operator<(Double4 a, Double4 b) { return _mm256_movemask_pd(_mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ)); }
+    friend int operator<=(Double4 a, Double4 b) { return _mm256_movemask_pd(_mm256_cmp_pd(a.v, b.v, _CMP_LE_OQ)); }
+    friend int operator>(Double4 a, Double4 b) { return _mm256_movemask_pd(_mm256_cmp_pd(a.v, b.v, _CMP_GT_OQ)); }
+    friend int operator>=(Double4 a, Double4 b) { return _mm256_movemask_pd(_mm256_cmp_pd(a.v, b.v, _CMP_GE_OQ)); }
+#else
+    friend Double4 operator+(Double4 a, Double4 b) { return apply(a, b, [](numberType x, numberType y) { return x + y; }); }
+    friend Double4 operator-(Double4 a, Double4 b) { return apply(a, b, [](numberType x, numberType y) { return x - y; }); }
+    friend Double4 operator*(Double4 a, Double4 b) { return apply(a, b, [](numberType x, numberType y) { return x * y; }); }
+    friend Double4 operator/(Double4 a, Double4 b) { return apply(a, b, [](numberType x, numberType y) { return x / y; }); }
+
+    friend Double4 max(Double4 a, Double4 b) { return apply(a, b, [](numberType x, numberType y) { return std::max(x, y); }); }
+    friend Double4 min(Double4 a, Double4 b) { return apply(a, b, [](numberType x, numberType y) { return std::min(x, y); }); }
+
+    friend Double4 selectBySign(Double4 sign, Double4 a, Double4 b) {
+        Double4 ret;
+        for (int i = 0; i < 4; ++i) ret.v[i] = std::signbit(sign.v[i]) ? b.v[i] : a.v[i];
+        return ret;
+    }
+
+    friend int operator<(Double4 a, Double4 b) { return compare(a, b, [](numberType x, numberType y) { return x < y; }); }
+    friend int operator<=(Double4 a, Double4 b) { return compare(a, b, [](numberType x, numberType y) { return x <= y; }); }
+    friend int operator>(Double4 a, Double4 b) { return compare(a, b, [](numberType x, numberType y) { return x > y; }); }
+    friend int operator>=(Double4 a, Double4 b) { return compare(a, b, [](numberType x, numberType y) { return x >= y; }); }
+#endif
+#pragma endregion
+
+private:
+#if !defined(__AVX__)
+    template<class Op>
+    static Double4
+    apply(Double4 a, Double4 b, Op op) {
+        Double4 ret;
+        for (int i = 0; i < 4; ++i) ret.v[i] = op(a.v[i], b.v[i]);
+        return ret;
+    }
+
+    template<class Op>
+    static int
+    compare(Double4 a, Double4 b, Op op) {
+        int ret = 0;
+        for (int i = 0; i < 4; ++i) ret |= op(a.v[i], b.v[i]) ? 1 << i : 0;
+        return ret;
+    }
+#endif
+};
+
+}
+
+#endif //ANYA_RENDERER_SIMD_HPP
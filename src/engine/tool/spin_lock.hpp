@@ -22,9 +22,9 @@ public:
     void
     lock() { while(flag.test_and_set(std::memory_order_acquire)); }
 
-    // 放弃自旋锁，当前线程把flag设置为false
+    // 放弃自旋锁，当前线程把flag设置为false，release语义保证临界区内的写入对下一个持锁线程可见
     void
-    unlock() { flag.clear(std::memory_order_acquire); }
+    unlock() { flag.clear(std::memory_order_release); }
 };
 
 }
@@ -0,0 +1,130 @@
+#ifndef ANYA_RENDERER_STATS_HPP
+#define ANYA_RENDERER_STATS_HPP
+
+#include "nlohmann/json.hpp"
+#include <array>
+#include <algorithm>
+
+namespace anya {
+
+// 渲染统计开关，编译时定义ANYA_NO_RENDER_STATS可去掉所有计数
+#ifdef ANYA_NO_RENDER_STATS
+inline constexpr bool renderStatsEnabled = false;
+#else
+inline constexpr bool renderStatsEnabled = true;
+#endif
+
+// 渲染统计计数器
+// 每个线程只在自己的thread_local计数器上累加，一次计数只是一条自增指令，没有原子操作与伪共享
+// 并行区域结束时由ThreadScope把各线程的计数合并到渲染器的stats中，render()返回后即为本次渲染的总计数
+struct RenderStats {
+    static constexpr int depthBins = 16;    // 路径长度直方图的桶数，最后一个桶包含更长的路径
+
+    long long cameraRays = 0;               // 相机光线
+    long long shadowRays = 0;               // 阴影光线(可见性测试)
+    long long indirectRays = 0;             // 弹射光线，包括whitted_style的反射与折射光线
+    long long nodesVisited = 0;             // BVH节点访问数，包括网格内部的BVH，光线包访问一个节点记一次
+    long long boxTests = 0;                 // 光线与包围盒的slab测试数，四叉节点一次访问记4次，光线包按有效光线数计
+    long long triangleTests = 0;            // 光线与三角形的求交测试数，光线包按有效光线数计
+    long long sphereTests = 0;              // 光线与球的求交测试数
+    long long rouletteTerminations = 0;     // 被俄罗斯轮盘赌终止的路径数
+    std::array<long long, depthBins> pathDepth{};  // 路径终止时的弹射次数的直方图
+    long long fragmentsShaded = 0;          // 光栅化中通过深度测试并着色的片元数
+    long long depthRejects = 0;             // 光栅化中未通过深度测试的片元数
+
+public:
+    // 在并行区域开头构造: 清空当前线程的计数器，析构时把它合并到total
+    class ThreadScope {
+    private:
+        RenderStats& total;
+
+    public:
+        explicit ThreadScope(RenderStats& t): total(t) {
+            if constexpr (renderStatsEnabled) local().clear();
+        }
+
+        ~ThreadScope() {
+            if constexpr (renderStatsEnabled) {
+                #pragma omp critical(anya_render_stats)
+                total += local();
+                local().clear();
+            }
+        }
+
+        ThreadScope(const ThreadScope&) = delete;
+        ThreadScope& operator=(const ThreadScope&) = delete;
+    };
+
+public:
+    // 当前线程的计数器
+    static RenderStats&
+    local() {
+        static thread_local RenderStats stats{};
+        return stats;
+    }
+
+    // 给当前线程的某个计数器加n
+    static void
+    count(long long RenderStats::* counter, long long n = 1) {
+        if constexpr (renderStatsEnabled) local().*counter += n;
+    }
+
+    // 记录一条终止时弹射了depth次的路径
+    void
+    addPath(int depth) {
+        if constexpr (renderStatsEnabled) ++pathDepth[std::clamp(depth, 0, depthBins - 1)];
+    }
+
+    void
+    clear() {
+        *this = RenderStats{};
+    }
+
+    [[nodiscard]] long long
+    rays() const {
+        return cameraRays + shadowRays + indirectRays;
+    }
+
+    RenderStats&
+    operator+=(const RenderStats& rhs) {
+        cameraRays += rhs.cameraRays;
+        shadowRays += rhs.shadowRays;
+        indirectRays += rhs.indirectRays;
+        nodesVisited += rhs.nodesVisited;
+        boxTests += rhs.boxTests;
+        triangleTests += rhs.triangleTests;
+        sphereTests += rhs.sphereTests;
+        rouletteTerminations += rhs.rouletteTerminations;
+        for (int i = 0; i < depthBins; ++i) pathDepth[i] += rhs.pathDepth[i];
+        fragmentsShaded += rhs.fragmentsShaded;
+        depthRejects += rhs.depthRejects;
+        return *this;
+    }
+
+    // 输出为JSON，附带每条光线的平均遍历代价，便于找出遍历代价异常的场景
+    [[nodiscard]] nlohmann::json
+    toJson() const {
+        double perRay = rays() > 0 ? 1.0 / double(rays()) : 0.0;
+        nlohmann::json ret;
+        ret["enabled"] = renderStatsEnabled;
+        ret["camera_rays"] = cameraRays;
+        ret["shadow_rays"] = shadowRays;
+        ret["indirect_rays"] = indirectRays;
+        ret["nodes_visited"] = nodesVisited;
+        ret["box_tests"] = boxTests;
+        ret["triangle_tests"] = triangleTests;
+        ret["sphere_tests"] = sphereTests;
+        ret["nodes_per_ray"] = nodesVisited * perRay;
+        ret["box_tests_per_ray"] = boxTests * perRay;
+        ret["primitive_tests_per_ray"] = (triangleTests + sphereTests) * perRay;
+        ret["path_depth"] = pathDepth;
+        ret["roulette_terminations"] = rouletteTerminations;
+        ret["fragments_shaded"] = fragmentsShaded;
+        ret["depth_rejects"] = depthRejects;
+        return ret;
+    }
+};
+
+}
+
+#endif //ANYA_RENDERER_STATS_HPP
@@ -0,0 +1,94 @@
+#ifndef ANYA_RENDERER_TILE_SCHEDULER_HPP
+#define ANYA_RENDERER_TILE_SCHEDULER_HPP
+
+#include "tool/spin_lock.hpp"
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace anya {
+
+// 图块，并行渲染的最小调度单元，[x0, x1) * [y0, y1)
+struct Tile {
+    int x0 = 0, y0 = 0;
+    int x1 = 0, y1 = 0;
+};
+
+// 工作窃取式的图块调度器
+// 每个工作线程拥有一个双端队列，优先从自己队列的头部取图块，
+// 自己的队列取空后再从其他线程队列的尾部窃取，以此平衡各线程的负载
+class TileScheduler {
+private:
+    struct WorkQueue {
+        spin_lock lock;
+        std::deque<Tile> tiles;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;  // 每个工作线程的图块队列
+    int count = 0;                                   // 图块总数
+
+public:
+    TileScheduler(int width, int height, int tileSize, int workers) {
+        workers = std::max(1, workers);
+        tileSize = std::max(1, tileSize);
+        for (int i = 0; i < workers; ++i) {
+            queues.push_back(std::make_unique<WorkQueue>());
+        }
+        // 按扫描线顺序将图块轮流分配给各个线程，相邻图块的开销相近，初始负载较为均衡
+        for (int y = 0; y < height; y += tileSize) {
+            for (int x = 0; x < width; x += tileSize) {
+                Tile tile{ x, y, std::min(x + tileSize, width), std::min(y + tileSize, height) };
+                queues[count % workers]->tiles.push_back(tile);
+                ++count;
+            }
+        }
+    }
+
+public:
+    // 为第 worker 个线程取出下一个图块，所有队列均为空时返回空
+    [[nodiscard]] std::optional<Tile>
+    next(int worker) {
+        int workers = static_cast<int>(queues.size());
+        worker %= workers;
+        // 先从自己的队列头部取
+        if (auto tile = popFront(*queues[worker])) {
+            return tile;
+        }
+        // 再依次从其他线程的队列尾部窃取
+        for (int i = 1; i < workers; ++i) {
+            if (auto tile = popBack(*queues[(worker + i) % workers])) {
+                return tile;
+            }
+        }
+        return {};
+    }
+
+    // 图块总数
+    [[nodiscard]] int
+    tileCount() const noexcept { return count; }
+
+private:
+    static std::optional<Tile>
+    popFront(WorkQueue& queue) {
+        std::lock_guard guard(queue.lock);
+        if (queue.tiles.empty()) return {};
+        Tile tile = queue.tiles.front();
+        queue.tiles.pop_front();
+        return tile;
+    }
+
+    static std::optional<Tile>
+    popBack(WorkQueue& queue) {
+        std::lock_guard guard(queue.lock);
+        if (queue.tiles.empty()) return {};
+        Tile tile = queue.tiles.back();
+        queue.tiles.pop_back();
+        return tile;
+    }
+};
+
+}
+
+#endif //ANYA_RENDERER_TILE_SCHEDULER_HPP
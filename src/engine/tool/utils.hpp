@@ -8,7 +8,6 @@
 #include <fstream>
 #include <numeric>
 #include <numbers>
-#include <random>
 #include "nlohmann/json.hpp"
 #include "component/light.hpp"
 
@@ -45,6 +44,15 @@ struct MathUtils {
         return v0 + k * (v1 - v0);
     }
 
+    // 向量的线性插值逐分量在一个循环内完成，不构造中间向量
+    template<int N>
+    static constexpr Vector<N>
+    lerp(numberType k, const Vector<N>& v0, const Vector<N>& v1) {
+        Vector<N> ret{};
+        for (int i = 0; i < N; ++i) ret[i] = v0[i] + k * (v1[i] - v0[i]);
+        return ret;
+    }
+
     // 重心坐标插值
     template<class T>
     static T
@@ -52,6 +60,15 @@ struct MathUtils {
         return (alpha * a + beta * b + gamma * c) * fixed;
     }
 
+    // 向量的重心坐标插值，光栅化中每个采样点都要插值多个属性，逐分量计算避免4个中间向量
+    template<int N>
+    static Vector<N>
+    interpolate(numberType alpha, numberType beta, numberType gamma, const Vector<N>& a, const Vector<N>& b, const Vector<N>& c, numberType fixed = 1.0) {
+        Vector<N> ret{};
+        for (int i = 0; i < N; ++i) ret[i] = (alpha * a[i] + beta * b[i] + gamma * c[i]) * fixed;
+        return ret;
+    }
+
     // 约束范围
     static constexpr numberType
     clamp(numberType lower, numberType upper, numberType val) {
@@ -77,14 +94,6 @@ struct MathUtils {
         }
         return ans;
     }
-
-    // 获取随机数
-    static numberType getRandNum(numberType l = 0.0, numberType r = 1.0) {
-        static std::random_device dev;
-        static std::mt19937 rng(dev());
-        static std::uniform_real_distribution<numberType> dist(l, r);
-        return dist(rng);
-    }
 };
 
 
@@ -139,6 +148,29 @@ struct Transform {
                  0, 0, 0, 1;
         return scale;
     }
+
+    // 非均匀缩放
+    static Matrix44
+    scale(const Vector3& ratio) {
+        Matrix44 scale{};
+        scale << ratio.x(), 0, 0, 0,
+                 0, ratio.y(), 0, 0,
+                 0, 0, ratio.z(), 0,
+                 0, 0, 0, 1;
+        return scale;
+    }
+#pragma endregion
+
+#pragma region 平移
+    static Matrix44
+    translate(const Vector3& offset) {
+        Matrix44 translate{};
+        translate << 1, 0, 0, offset.x(),
+                     0, 1, 0, offset.y(),
+                     0, 0, 1, offset.z(),
+                     0, 0, 0, 1;
+        return translate;
+    }
 #pragma endregion
 };
 
@@ -9,55 +9,61 @@
 #include <algorithm>
 #include <iostream>
 #include <concepts>
-#include <GLFW/glfw3.h>
+#include <stdexcept>
 
 namespace anya {
 
-using numberType = GLdouble;
+// 引擎不依赖GLFW与OpenGL，可以在没有显示设备的节点上编译运行
+using numberType = double;
 
-template<int N> requires(N >= 1)
+// N维向量，T为分量类型，默认为numberType(双精度)，几何与着色中内存密集的数据可以使用单精度实例化
+template<int N, class T = numberType> requires(N >= 1)
 class Vector {
 private:
     // 底层数据存储
-    numberType data[N]{};
+    T data[N]{};
 
 public:
 #pragma region 构造相关
     constexpr Vector() = default;
     // 超过向量长度的数据将被丢弃
-    constexpr Vector(const std::initializer_list<numberType>& st) {
+    constexpr Vector(const std::initializer_list<T>& st) {
         auto it = st.begin();
         for (int i = 0; it < st.end() && i < N; ++i, ++it)
             data[i] = *it;
     }
+
+    // 不同分量类型之间的显式转换，eg: Vector3(Vector3f{...})
+    template<class U>
+    constexpr explicit Vector(const Vector<N, U>& rhs) {
+        for (int i = 0; i < N; ++i)
+            data[i] = static_cast<T>(rhs[i]);
+    }
 #pragma endregion
 
 public:
 #pragma region 访问
-    // 下标访问，并进行越界检查，支持[]访问和()访问，两者等价
-    constexpr numberType&
+    // 下标访问，支持[]访问和()访问，两者等价
+    // 只在调试构建(未定义NDEBUG)中进行越界检查，发布构建中为无分支的直接访问
+    constexpr T&
     operator[](const int index) {
-        if (out_range(index))
-            throw std::out_of_range("Vector::operator[]");
+        check(index);
         return data[index];
     }
-    constexpr const numberType&
+    constexpr const T&
     operator[](const int index) const {
-        if (out_range(index))
-            throw std::out_of_range("Vector::operator[]");
+        check(index);
         return data[index];
     }
 
-    constexpr numberType&
+    constexpr T&
     operator()(const int index) {
-        if (out_range(index))
-            throw std::out_of_range("Vector::operator[]");
+        check(index);
         return data[index];
     }
-    constexpr const numberType&
+    constexpr const T&
     operator()(const int index) const {
-        if (out_range(index))
-            throw std::out_of_range("Vector::operator[]");
+        check(index);
         return data[index];
     }
 
@@ -69,7 +75,7 @@ public:
     size() const noexcept { return N; }
 
     // 返回底层数组
-    constexpr numberType* toRawArray() noexcept {
+    constexpr T* toRawArray() noexcept {
         return this->data;
     }
 
@@ -78,11 +84,11 @@ public:
 public:
 #pragma region 向量运算
     // 点乘，隐含了维数一致的约束，即维数都为N
-    [[nodiscard]] constexpr numberType
+    [[nodiscard]] constexpr T
     dot(const Vector& rhs) const noexcept {
-        numberType ret = {};
+        T ret = {};
         for (int i = 0; i < N; ++i)
-            ret += (*this)[i] * rhs[i];
+            ret += data[i] * rhs.data[i];
         return ret;
     }
 
@@ -92,10 +98,10 @@ public:
     //                                |k v3 w3|
     [[nodiscard]] constexpr Vector
     cross(const Vector& rhs) const noexcept requires(N == 3) {
-        const Vector& lhs = *this;
-        return { lhs[1] * rhs[2] - rhs[1] * lhs[2],
-                -lhs[0] * rhs[2] + rhs[0] * lhs[2],
-                 lhs[0] * rhs[1] - rhs[0] * lhs[1]
+        const T* lhs = data;
+        return { lhs[1] * rhs.data[2] - rhs.data[1] * lhs[2],
+                -lhs[0] * rhs.data[2] + rhs.data[0] * lhs[2],
+                 lhs[0] * rhs.data[1] - rhs.data[0] * lhs[1]
         };
     }
 
@@ -104,7 +110,7 @@ public:
     mut(const Vector& rhs) const noexcept {
         Vector ret{};
         for (int i = 0; i < N; ++i) {
-            ret[i] = data[i] * rhs[i];
+            ret.data[i] = data[i] * rhs.data[i];
         }
         return ret;
     }
@@ -114,13 +120,23 @@ public:
     div(const Vector& rhs) const {
         Vector ret{};
         for (int i = 0; i < N; ++i) {
-            ret[i] = data[i] / rhs[i];
+            ret.data[i] = data[i] / rhs.data[i];
+        }
+        return ret;
+    }
+
+    // 最大分量
+    [[nodiscard]] constexpr T
+    maxComponent() const noexcept {
+        T ret = data[0];
+        for (int i = 1; i < N; ++i) {
+            ret = std::max(ret, data[i]);
         }
         return ret;
     }
 
     // 向量的L2范数，也就是向量的膜
-    [[nodiscard]] constexpr numberType
+    [[nodiscard]] constexpr T
     norm2() const { return std::sqrt(dot(*this)); }
 
     // 将向量归一化为单位向量
@@ -128,25 +144,25 @@ public:
     normalize() const { return *this / norm2(); }
 
     // 向量夹角 [0, pi]
-    [[nodiscard]] constexpr numberType
+    [[nodiscard]] constexpr T
     angle(const Vector& rhs) const {
         return std::acos( this->dot(rhs) / (this->norm2() * rhs.norm2()) );
     }
 
     // 转换为其他维数的向量
     template<int M>
-    constexpr Vector<M> to(numberType fill = 0.0) const {
-        Vector<M> ret{};
+    constexpr Vector<M, T> to(T fill = 0.0) const {
+        Vector<M, T> ret{};
         for (int i = 0; i < M; ++i) {
-            ret[i] = out_range(i) ? fill : (*this)[i];
+            ret[i] = out_range(i) ? fill : data[i];
         }
         return ret;
     }
 
     // 三维向量转换为齐次坐标向量
-    [[nodiscard]] constexpr Vector<4>
-    to4(numberType fill = 1.0) const requires(N == 3) {
-        Vector<4> ret = to<4>();
+    [[nodiscard]] constexpr Vector<4, T>
+    to4(T fill = 1.0) const requires(N == 3) {
+        Vector<4, T> ret = to<4>();
         ret(3) = fill;
         return ret;
     }
@@ -157,10 +173,9 @@ public:
     // 向量加法
     constexpr Vector&
     operator+=(const Vector& rhs) noexcept {
-        Vector& lhs = *this;
         for (int i = 0; i < N; ++i)
-            lhs[i] += rhs[i];
-        return lhs;
+            data[i] += rhs.data[i];
+        return *this;
     }
 
     constexpr friend Vector
@@ -169,10 +184,9 @@ public:
     // 向量减法
     constexpr Vector&
     operator-=(const Vector& rhs) noexcept {
-        Vector& lhs = *this;
         for (int i = 0; i < N; ++i)
-            lhs[i] -= rhs[i];
-        return lhs;
+            data[i] -= rhs.data[i];
+        return *this;
     }
 
     constexpr friend Vector
@@ -184,25 +198,57 @@ public:
 
     // 向量伸缩
     constexpr Vector&
-    operator*=(numberType k) noexcept {
+    operator*=(T k) noexcept {
         for (auto& i : this->data) i *= k;
         return *this;
     }
 
     constexpr friend Vector
-    operator*(const Vector& lhs, numberType k) noexcept { return Vector{lhs} *= k; }
+    operator*(const Vector& lhs, T k) noexcept { return Vector{lhs} *= k; }
 
     constexpr friend Vector
-    operator*(numberType k, const Vector& rhs) noexcept { return Vector{rhs} *= k; }
+    operator*(T k, const Vector& rhs) noexcept { return Vector{rhs} *= k; }
 
     constexpr Vector&
-    operator/=(numberType k) {
+    operator/=(T k) {
         for (auto& i : this->data) i /= k;
         return *this;
     }
 
     constexpr friend Vector
-    operator/(const Vector& lhs, numberType k) { return Vector{lhs} /= k; }
+    operator/(const Vector& lhs, T k) { return Vector{lhs} /= k; }
+
+#pragma endregion
+
+public:
+#pragma region 融合运算
+    // 着色中常见的复合表达式在一个循环内完成，不构造中间向量
+    // 每个分量的运算顺序与展开的写法相同，结果逐位一致
+
+    // 等价于 mut(rhs) * k
+    [[nodiscard]] constexpr Vector
+    mut(const Vector& rhs, T k) const noexcept {
+        Vector ret{};
+        for (int i = 0; i < N; ++i)
+            ret.data[i] = data[i] * rhs.data[i] * k;
+        return ret;
+    }
+
+    // 等价于 *this += a * k
+    constexpr Vector&
+    madd(const Vector& a, T k) noexcept {
+        for (int i = 0; i < N; ++i)
+            data[i] += a.data[i] * k;
+        return *this;
+    }
+
+    // 等价于 *this += a.mut(b) * k
+    constexpr Vector&
+    madd(const Vector& a, const Vector& b, T k) noexcept {
+        for (int i = 0; i < N; ++i)
+            data[i] += a.data[i] * b.data[i] * k;
+        return *this;
+    }
 
 #pragma endregion
 
@@ -223,35 +269,35 @@ public:
 
 public:
 #pragma region 坐标
-    [[nodiscard]] constexpr numberType&
+    [[nodiscard]] constexpr T&
     x() noexcept requires(N >= 1) { return this->data[0]; }
 
-    [[nodiscard]] constexpr numberType&
+    [[nodiscard]] constexpr T&
     y() noexcept requires(N >= 2) { return this->data[1]; }
 
-    [[nodiscard]] constexpr numberType&
+    [[nodiscard]] constexpr T&
     z() noexcept requires(N >= 3) { return this->data[2]; }
 
-    [[nodiscard]] constexpr numberType&
+    [[nodiscard]] constexpr T&
     w() noexcept requires(N >= 4) { return this->data[3]; }
 
-    [[nodiscard]] constexpr const numberType&
+    [[nodiscard]] constexpr const T&
     x() const noexcept requires(N >= 1) { return this->data[0]; }
 
-    [[nodiscard]] constexpr const numberType&
+    [[nodiscard]] constexpr const T&
     y() const noexcept requires(N >= 2) { return this->data[1]; }
 
-    [[nodiscard]] constexpr const numberType&
+    [[nodiscard]] constexpr const T&
     z() const noexcept requires(N >= 3) { return this->data[2]; }
 
-    [[nodiscard]] constexpr const numberType&
+    [[nodiscard]] constexpr const T&
     w() const noexcept requires(N >= 4) { return this->data[3]; }
 
     // w != 0 时，该齐次坐标代表一个点，将该点标准化表示
     [[nodiscard]] constexpr Vector
     trim() const noexcept requires(N >= 4) {
         auto w = this->w();
-        if (fabs(w) > 1e-8) return *this / w;
+        if (std::abs(w) > 1e-8) return *this / w;
         return *this;
     }
 
@@ -264,6 +310,14 @@ private:
         return i < 0 || i >= N;
     }
 
+    constexpr static void
+    check([[maybe_unused]] int i) {
+#ifndef NDEBUG
+        if (out_range(i))
+            throw std::out_of_range("Vector::operator[]");
+#endif
+    }
+
 #pragma endregion
 
 };
@@ -275,6 +329,24 @@ using Vector2 = Vector<2>;
 using Vector3 = Vector<3>;
 // 四元数/四维向量
 using Vector4 = Vector<4>;
+// 单精度向量，用于顶点、纹理等内存密集的数据
+using Vector2f = Vector<2, float>;
+using Vector3f = Vector<3, float>;
+using Vector4f = Vector<4, float>;
+
+// 填充到4个分量并按4个分量的宽度对齐的三维向量，一次SIMD读写即可取出整个向量，填充分量恒为0
+template<class T>
+class alignas(4 * sizeof(T)) PaddedVector3: public Vector<3, T> {
+private:
+    T pad{};
+
+public:
+    constexpr PaddedVector3() = default;
+    constexpr PaddedVector3(const Vector<3, T>& v): Vector<3, T>(v) {}
+};
+
+using Vector3fA = PaddedVector3<float>;
+static_assert(sizeof(Vector3fA) == 16, "Vector3fA should be 16 bytes");
 
 // 便捷创建向量
 template<typename... Args>
@@ -1,29 +1,151 @@
 #include <iostream>
-#include "ui/gui.hpp"
+#include <fstream>
+#include <chrono>
 #include "component/camera.hpp"
 #include "load/context.hpp"
 #include "renderer/raytracer.hpp"
+#ifdef ANYA_WITH_GUI
+#include "ui/gui.hpp"
 #include "test/test.h"
+#endif
 
 using namespace anya;
 
+// 命令行参数，未指定的项沿用场景配置
+struct Options {
+    std::string scene = "../art/context/cornell_sphere.json";  // 场景配置
+    std::string output;                                        // 输出图片路径，为空时使用配置中的image字段
+    int spp = 0;                                               // 覆盖采样数，0表示不覆盖
+    int threads = -1;                                          // 覆盖渲染线程数，-1表示不覆盖
+    std::string stats;                                         // 渲染统计的输出路径，为空时不输出
+    std::string trace;                                         // Chrome trace格式的剖析结果的输出路径，为空时不剖析
+    std::string heatmap;                                       // 代价热力图的度量，为空时沿用场景配置
+    bool gui = true;                                           // 是否打开窗口预览，无GUI的构建中恒为false
+};
+
+void usage() {
+    std::cerr << "usage: anya-render [scene.json] [-o output.png] [--spp N] [--threads N] [--stats stats.json] [--trace trace.json]"
+                 " [--heatmap time|nodes|primitives|fragments] [--no-gui]" << std::endl;
+}
+
+// 解析命令行，参数错误时返回false
+bool parseOptions(int argc, char** argv, Options& options) {
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            auto next = [&]() -> std::string {
+                if (i + 1 >= argc) throw std::invalid_argument("missing value for " + arg);
+                return argv[++i];
+            };
+            if (arg == "-o" || arg == "--output") options.output = next();
+            else if (arg == "--spp") options.spp = std::stoi(next());
+            else if (arg == "--threads") options.threads = std::stoi(next());
+            else if (arg == "--stats") options.stats = next();
+            else if (arg == "--trace") options.trace = next();
+            else if (arg == "--heatmap") options.heatmap = next();
+            else if (arg == "--no-gui") options.gui = false;
+            else if (arg == "-h" || arg == "--help") return false;
+            else if (!arg.empty() && arg[0] == '-') throw std::invalid_argument("unknown option " + arg);
+            else options.scene = arg;
+        }
+    } catch (const std::exception& err) {
+        std::cerr << err.what() << std::endl;
+        return false;
+    }
+#ifndef ANYA_WITH_GUI
+    options.gui = false;
+#endif
+    return true;
+}
+
+#ifdef ANYA_WITH_GUI
 void show(const std::shared_ptr<Renderer>& renderer) {
     auto [w, h] = renderer->scene.camera->getWH();
     GUI gui("AnyaRenderer", w, h, renderer);
     gui.run();
 }
+#endif
+
+// 代价热力图与输出图片同目录，文件名追加 _heatmap_${metric}，并打印色带上限以便读图
+bool saveHeatmap(const Renderer& renderer) {
+    const auto& path = renderer.savePathName;
+    auto dot = path.find_last_of('.');
+    std::string heatmapPath = path.substr(0, dot) + "_heatmap_" + CostHeatmap::name(renderer.heatmap.getMetric()) + path.substr(dot);
+    if (!renderer.heatmap.toImage()->saveToDisk(heatmapPath)) {
+        std::cerr << "failed to save " << heatmapPath << std::endl;
+        return false;
+    }
+    std::cout << "heatmap saved to " << heatmapPath << " (" << CostHeatmap::name(renderer.heatmap.getMetric())
+              << ", scale " << renderer.heatmap.scale() << ", max " << renderer.heatmap.max() << ")" << std::endl;
+    return true;
+}
+
+// 不打开窗口，渲染完成后直接写入图片，用于没有显示设备的节点上批量渲染
+bool renderToDisk(const std::shared_ptr<Renderer>& renderer, const std::string& statsPath) {
+    auto start = std::chrono::steady_clock::now();
+    renderer->render();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "render time: " << seconds << "s" << std::endl;
+    if (!statsPath.empty()) {
+        std::ofstream ofs(statsPath);
+        ofs << renderer->stats.toJson().dump(2) << std::endl;
+        if (!ofs) std::cerr << "failed to write " << statsPath << std::endl;
+    }
+    if (!renderer->outPutImage->saveToDisk(renderer->savePathName)) {
+        std::cerr << "failed to save " << renderer->savePathName << std::endl;
+        return false;
+    }
+    std::cout << "saved to " << renderer->savePathName << std::endl;
+    return !renderer->heatmap.enabled() || saveHeatmap(*renderer);
+}
+
+// 停止剖析并写出时间线
+void writeTrace(const std::string& path) {
+    if (path.empty()) return;
+    Profiler::stop();
+    if (Profiler::writeChromeTrace(path)) std::cout << "trace saved to " << path << std::endl;
+    else std::cerr << "failed to write " << path << std::endl;
+}
+
+int runTask(const Options& options) {
+    // 剖析从加载场景开始，覆盖加载、BVH构建、渲染与图片编码
+    if (!options.trace.empty()) Profiler::start();
+    json config;
+    try {
+        config = JsonUtils::load(options.scene);
+    } catch (const std::exception& err) {
+        std::cerr << "failed to load " << options.scene << ": " << err.what() << std::endl;
+        return 1;
+    }
+    if (options.spp > 0) config["renderer"]["spp"] = options.spp;
+    if (options.threads >= 0) config["renderer"]["threads"] = options.threads;
+    if (!options.heatmap.empty()) config["renderer"]["heatmap"] = options.heatmap;
 
-void runTask(const std::string& path) {
     Context context;
-    context.loadFromJson(JsonUtils::load(path));
-    show(context._renderer);
+    if (!context.loadFromJson(config)) return 1;
+    if (!options.output.empty()) context._renderer->savePathName = options.output;
+
+#ifdef ANYA_WITH_GUI
+    if (options.gui) {
+        show(context._renderer);
+        writeTrace(options.trace);
+        return 0;
+    }
+#endif
+    bool ok = renderToDisk(context._renderer, options.stats);
+    writeTrace(options.trace);
+    return ok ? 0 : 1;
 }
 
 
 
-int main() {
-    runTask("../art/context/cornell_sphere.json");
-    return 0;
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage();
+        return 1;
+    }
+    return runTask(options);
 }
 
 
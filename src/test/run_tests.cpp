@@ -0,0 +1,41 @@
+#include "test.h"
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// 无窗口的测试入口: anya-test [name ...]，不指定名字时运行全部测试，任一测试失败时返回1
+// 在 src 目录下运行，场景中的资源路径相对于该目录；ctest为每个测试注册一项
+
+int main(int argc, char** argv) {
+    const std::map<std::string, std::function<bool()>> tests{
+        { "vec", [] { vecTest(); return true; } },
+        { "matrix", [] { matrixTest(); return true; } },
+        { "direct_lighting", testDirectLighting },
+        { "instance_area", testInstanceArea },
+        { "convergence", testConvergence },
+        { "wavefront", testWavefront },
+        { "wide_bvh", testWideBVH },
+        { "bvh_depth", testBVHDepth },
+        { "vector_fusion", testVectorFusion },
+    };
+
+    std::vector<std::string> names(argv + 1, argv + argc);
+    if (names.empty()) {
+        for (const auto& [name, test] : tests) names.push_back(name);
+    }
+    bool ok = true;
+    for (const auto& name : names) {
+        auto it = tests.find(name);
+        if (it == tests.end()) {
+            std::cerr << "unknown test " << name << std::endl;
+            ok = false;
+            continue;
+        }
+        bool passed = it->second();
+        std::cout << (passed ? "[PASS] " : "[FAIL] ") << name << std::endl;
+        ok = ok && passed;
+    }
+    return ok ? 0 : 1;
+}
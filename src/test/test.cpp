@@ -2,6 +2,12 @@
 // Created by Anya on 2022/12/3.
 //
 #include "test.h"
+#include "tool/utils.hpp"
+#include "interface/renderer.hpp"
+#include "renderer/rasterizer.hpp"
+#include "load/context.hpp"
+#include <chrono>
+#include <functional>
 using namespace anya;
 
 void vecTest() {
@@ -211,6 +217,7 @@ void matrixTest() {
     }
 }
 
+#ifdef ANYA_WITH_GUI
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
     // make sure the viewport matches the new window dimensions; note that width and
     // height will be significantly larger than specified on retina displays.
@@ -221,4 +228,336 @@ void processInput(GLFWwindow *window) {
     if(glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 }
+#endif
 
+// Բ: Ա path_tracing  path_tracing_mis ڲͬsppԸԲοͼ
+// ȡضϵ [0, 1] RMSEʾԴ
+// cornell_boxsppСcornell_sphereоĽɢֻBSDFõβֲ
+// ضϺRMSEڵspp²ֻ
+bool testConvergence() {
+    const int size = 64;
+    const int referenceSpp = 1024;
+    const std::vector<int> sppList{ 4, 16, 64 };
+
+    auto renderImage = [size](const std::string& scenePath, const std::string& mode, int spp, std::uint32_t seed) {
+        json config = JsonUtils::load(scenePath);
+        config["camera"]["view_width"] = size;
+        config["camera"]["view_height"] = size;
+        config["renderer"]["mode"] = mode;
+        config["renderer"]["spp"] = spp;
+        config["renderer"]["seed"] = seed;
+        Context context;
+        context.loadFromJson(config);
+        context._renderer->render();
+        std::vector<Vector3> image;
+        for (int y = 0; y < size; ++y) {
+            for (int x = 0; x < size; ++x) {
+                image.push_back(context._renderer->getPixel(x, y));
+            }
+        }
+        return image;
+    };
+    auto rmse = [](const std::vector<Vector3>& lhs, const std::vector<Vector3>& rhs) {
+        numberType sum = 0.0;
+        for (std::size_t i = 0; i < lhs.size(); ++i) {
+            for (int k = 0; k < 3; ++k) {
+                numberType d = MathUtils::clamp(0, 1, lhs[i][k]) - MathUtils::clamp(0, 1, rhs[i][k]);
+                sum += d * d;
+            }
+        }
+        return std::sqrt(sum / (3.0 * lhs.size()));
+    };
+
+    std::vector<std::pair<std::string, bool>> scenes{ { "../art/context/cornell_box.json", true }, { "../art/context/cornell_sphere.json", false } };
+    std::vector<std::string> modes{ "path_tracing", "path_tracing_mis" };
+    std::vector<std::string> report;
+    bool ok = true;
+    for (const auto& [scene, checked] : scenes) {
+        for (const auto& mode : modes) {
+            auto reference = renderImage(scene, mode, referenceSpp, 1);
+            numberType last = inf;
+            for (int spp : sppList) {
+                auto start = std::chrono::steady_clock::now();
+                auto image = renderImage(scene, mode, spp, 2);
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                numberType error = rmse(image, reference);
+                ok = ok && (!checked || error < last);
+                last = error;
+                report.push_back(scene + " " + mode + " spp " + std::to_string(spp)
+                                 + " rmse " + std::to_string(error)
+                                 + " time " + std::to_string(seconds) + "s");
+            }
+        }
+    }
+    std::cout << std::endl << "ԲԽ:" << std::endl;
+    for (const auto& line : report) {
+        std::cout << line << std::endl;
+    }
+    return ok;
+}
+
+// ֱӹղ: Դƽ޴ƽ棬Դ·һĳн L = kd * Le * F
+// FΪõ㵽ε״ӣԴMISʵ޹أֱӹյĶο
+// cornell_boxͬһϣʱƫepsilonܱ¶Ӱ߱Դסƫ
+bool testDirectLighting() {
+    const int size = 16;
+    const numberType kd = 0.5, h = 100.0, a = 50.0, W = 1e4;   // ʣԴƽľ룬Դ߳ƽ߳
+    const numberType cx = 300.0, cy = 300.0, cz = 500.0;         // ۲
+    auto material = [](numberType k, bool light) {
+        return json{ { "type", "DIFFUSE_AND_GLOSSY" }, { "kd", { k, k, k } }, { "isLight", light } };
+    };
+    auto triangle = [](const json& vertexes, const json& material) {
+        return json{ { "type", "triangle" }, { "vertexes", vertexes }, { "stCoordinates", { { 0, 0 }, { 1, 0 }, { 1, 1 } } }, { "material", material } };
+    };
+    // +zƽ淨߳-zԴ߳+zӽǺСضڹ۲㸽
+    json config;
+    config["image"] = { { "name", "direct_lighting" }, { "suffix", "png" } };
+    config["camera"] = { { "eye_pos", { cx, cy, cz - 50 } }, { "obj_pos", { 0, 0, 1 } }, { "view_width", size }, { "view_height", size }, { "fovY", 1 } };
+    config["objects"] = json::array({
+        triangle({ { cx - W, cy - W, cz }, { cx + W, cy + W, cz }, { cx + W, cy - W, cz } }, material(kd, false)),
+        triangle({ { cx - W, cy - W, cz }, { cx - W, cy + W, cz }, { cx + W, cy + W, cz } }, material(kd, false)),
+        triangle({ { cx - a, cy - a, cz - h }, { cx + a, cy - a, cz - h }, { cx + a, cy + a, cz - h } }, material(0, true)),
+        triangle({ { cx - a, cy - a, cz - h }, { cx + a, cy + a, cz - h }, { cx - a, cy + a, cz - h } }, material(0, true)),
+    });
+    numberType s = a / std::sqrt(a * a + h * h);
+    numberType formFactor = 4.0 / pi * s * std::atan(s);
+
+    bool ok = true;
+    std::cout << std::endl << "ֱӹղԽ:" << std::endl;
+    for (const std::string type : { "RayTracer", "WavefrontRayTracer" }) {
+        for (const std::string mode : { "path_tracing", "path_tracing_mis" }) {
+            config["renderer"] = { { "type", type }, { "background", { 0, 0, 0 } }, { "mode", mode }, { "spp", 64 }, { "seed", 1 } };
+            Context context;
+            if (!context.loadFromJson(config)) return false;
+            context._renderer->render();
+            Vector3 mean{};
+            for (int y = 0; y < size; ++y) {
+                for (int x = 0; x < size; ++x) {
+                    mean += context._renderer->getPixel(x, y) / (size * size);
+                }
+            }
+            Vector3 expected = context._renderer->scene.objects.back()->getEmission() * (kd * formFactor);
+            numberType error = 0.0;
+            for (int k = 0; k < 3; ++k) error = std::max(error, std::fabs(mean[k] / expected[k] - 1.0));
+            ok = ok && error < 0.01;
+            std::cout << type << " " << mode << " radiance " << mean[0] << " expected " << expected[0] << " relative error " << error << std::endl;
+        }
+    }
+    return ok;
+}
+
+// ʵ: Ǿ + ת£ʵpdfӦ任εʵһ£Ƕʵͬ
+bool testInstanceArea() {
+    auto triangle = std::make_shared<Triangle>();
+    triangle->vertexes = { Vector4{ 1, 0, 0, 1 }, Vector4{ 0, 1, 0, 1 }, Vector4{ 0, 0, 1, 1 } };
+    triangle->material = std::make_shared<DiffuseMaterial>();
+    Matrix44 inner = Transform::RotateAroundN(0.7, { 1, 2, 3 }) * Transform::scale(Vector3{ 2, 3, 5 });
+    Matrix44 outer = Transform::translate({ 10, 0, 0 }) * Transform::scale(Vector3{ 1, 4, 0.5 });
+    auto instance = std::make_shared<Instance>(triangle, triangle->material, inner);
+    auto nested = std::make_shared<Instance>(instance, triangle->material, outer);
+
+    // 任Χɵ
+    auto reference = [&triangle](const Matrix44& m) {
+        Vector3 v[3];
+        for (int i = 0; i < 3; ++i) v[i] = (m * triangle->vertexes[i]).to<3>();
+        return (v[1] - v[0]).cross(v[2] - v[0]).norm2() * 0.5;
+    };
+    bool ok = true;
+    std::cout << std::endl << "ʵԽ:" << std::endl;
+    for (const auto& [object, transform] : { std::pair{ instance, inner }, std::pair{ nested, outer * inner } }) {
+        numberType expected = reference(transform);
+        Sampler sampler(0, 0, 1);
+        numberType pdf = object->samplePrimitive(0, sampler).second;
+        numberType error = std::max(std::fabs(object->getArea() / expected - 1.0), std::fabs(pdf * expected - 1.0));
+        ok = ok && error < 1e-9;
+        std::cout << "area " << object->getArea() << " pdf " << pdf << " expected area " << expected << " relative error " << error << std::endl;
+    }
+    return ok;
+}
+
+// ǰʽȾ: RayTracerͬȾͬһȽϺʱǷλһ
+bool testWavefront() {
+    const int size = 128;
+    const int spp = 16;
+    auto renderImage = [size, spp](const std::string& type, std::vector<Vector3>& image) {
+        json config = JsonUtils::load("../art/context/cornell_box.json");
+        config["camera"]["view_width"] = size;
+        config["camera"]["view_height"] = size;
+        config["renderer"]["type"] = type;
+        config["renderer"]["mode"] = "path_tracing_mis";
+        config["renderer"]["spp"] = spp;
+        config["renderer"]["seed"] = 1;
+        Context context;
+        context.loadFromJson(config);
+        auto start = std::chrono::steady_clock::now();
+        context._renderer->render();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        image.clear();
+        for (int y = 0; y < size; ++y) {
+            for (int x = 0; x < size; ++x) {
+                image.push_back(context._renderer->getPixel(x, y));
+            }
+        }
+        return seconds;
+    };
+
+    std::vector<Vector3> reference, wavefront;
+    double referenceTime = renderImage("RayTracer", reference);
+    double wavefrontTime = renderImage("WavefrontRayTracer", wavefront);
+    int mismatch = 0;
+    for (std::size_t i = 0; i < reference.size(); ++i) {
+        for (int k = 0; k < 3; ++k) {
+            mismatch += reference[i][k] != wavefront[i][k];
+        }
+    }
+    std::cout << std::endl << "RayTracer: " << referenceTime << "s, WavefrontRayTracer: " << wavefrontTime << "s" << std::endl;
+    std::cout << "һµط: " << mismatch << std::endl;
+    return mismatch == 0;
+}
+
+// ĲBVHܲ: ֱöĲBVHԳߵ㣬Ƚ(Mrays/s)ÿ߷ʵĽڵ
+// ڵRenderStatsANYA_NO_RENDER_STATSʱΪ0BVHеĹͬ
+bool testWideBVH() {
+    const int size = 512;
+    std::vector<std::string> scenes{ "../art/context/bunny.json", "../art/context/cornell_box.json" };
+    std::vector<std::string> report;
+    bool ok = true;
+    for (const auto& scene : scenes) {
+        int binaryHits = -1;
+        for (int width : { 2, 4 }) {
+            json config = JsonUtils::load(scene);
+            config["camera"]["view_width"] = size;
+            config["camera"]["view_height"] = size;
+            config["renderer"]["bvh"]["width"] = width;
+            Context context;
+            context.loadFromJson(config);
+            const auto& renderer = context._renderer;
+            // RayTracer::rayFixedһµ߷
+            Vector3 fixed = renderer->mode == RenderMode::WHITTED_STYLE ? Vector3{ 1, 1, -1 } : Vector3{ -1, 1, 1 };
+            std::vector<Ray> rays;
+            for (int j = 0; j < size; ++j) {
+                for (int i = 0; i < size; ++i) {
+                    Sampler sampler(static_cast<std::uint32_t>(j * size + i), 0, 1);
+                    auto ray = renderer->scene.camera->biuRay(i, j, sampler);
+                    ray.setDir(ray.dir.mut(fixed));
+                    rays.push_back(ray);
+                }
+            }
+
+            RenderStats::local().clear();
+            int hits = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (const auto& ray : rays) {
+                HitRecord rec{};
+                hits += renderer->scene.bvh->intersect(ray, rec);
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (binaryHits < 0) binaryHits = hits;
+            ok = ok && hits == binaryHits;
+            report.push_back(scene + " width " + std::to_string(width)
+                             + " hits " + std::to_string(hits)
+                             + " Mrays/s " + std::to_string(rays.size() / seconds * 1e-6)
+                             + " nodes/ray " + std::to_string(double(RenderStats::local().nodesVisited) / rays.size()));
+        }
+    }
+    std::cout << std::endl << "ĲBVHܲԽ:" << std::endl;
+    for (const auto& line : report) {
+        std::cout << line << std::endl;
+    }
+    return ok;
+}
+
+// BVHȲ: Χаȱֻ2ͰʱSAHÿֻһͼԪӦڱջڣұܷʵȫͼԪ
+bool testBVHDepth() {
+    const int count = 90;  // ڵΧΪȣ2.5^91floatΧ
+    std::vector<AABB> bounds;
+    for (int i = 0; i < count; ++i) {
+        numberType x = std::pow(2.5, i);
+        bounds.emplace_back(Vector3{ x, -1, -1 }, Vector3{ 2.5 * x, 1, 1 });
+    }
+    // ԽڵindexΪ
+    std::function<int(const BVH&, int)> depthOf = [&depthOf](const BVH& bvh, int index) {
+        const auto& node = bvh.nodes[index];
+        if (node.primitiveCount > 0) return 0;
+        return 1 + std::max(depthOf(bvh, index + 1), depthOf(bvh, node.secondChildOffset));
+    };
+
+    bool ok = true;
+    std::cout << std::endl << "BVHȲԽ:" << std::endl;
+    for (int width : { 2, 4 }) {
+        std::vector<int> order;
+        BVH bvh(bounds, order, BVHConfig{ .bins = 2, .threads = 1, .width = width });
+        int depth = depthOf(bvh, 0);
+        // +xĹߴаΧУҶӲ潻㣬ÿͼԪӦһ
+        int tested = 0;
+        numberType tMax = KMAX;
+        bvh.intersect(Ray{ Vector3{ 0, 0, 0 }, Vector3{ 1, 0, 0 } }, tMax, [&tested](int, int n, numberType&) {
+            tested += n;
+            return false;
+        });
+        ok = ok && depth <= BVH::maxStackDepth && tested == count;
+        std::cout << "width " << width << " depth " << depth << " primitives tested " << tested << std::endl;
+    }
+    return ok;
+}
+
+// ںܲ: ɫеĸʽֱչдں㣬ȽÿĺʱǷλһ
+bool testVectorFusion() {
+    const int count = 4096;
+    const int repeat = 2000;
+    Sampler sampler(1, 0, 1);
+    auto randomVec = [&sampler]() { return Vector3{ sampler.get1D(), sampler.get1D(), sampler.get1D() }; };
+    std::vector<Vector3> a(count), b(count), c(count);
+    std::vector<numberType> k(count);
+    for (int i = 0; i < count; ++i) {
+        a[i] = randomVec();
+        b[i] = randomVec();
+        c[i] = randomVec();
+        k[i] = sampler.get1D() + 0.5;
+    }
+
+    std::vector<std::string> report;
+    bool ok = true;
+    auto bench = [&report, &ok](const std::string& name, auto&& expanded, auto&& fused) {
+        Vector3 sum0{}, sum1{};
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < repeat; ++r) {
+            for (int i = 0; i < count; ++i) sum0 += expanded(i);
+        }
+        auto middle = std::chrono::steady_clock::now();
+        for (int r = 0; r < repeat; ++r) {
+            for (int i = 0; i < count; ++i) sum1 += fused(i);
+        }
+        auto end = std::chrono::steady_clock::now();
+        double ops = double(count) * repeat;
+        bool identical = sum0[0] == sum1[0] && sum0[1] == sum1[1] && sum0[2] == sum1[2];
+        ok = ok && identical;
+        report.push_back(name
+                         + " expanded " + std::to_string(std::chrono::duration<double, std::nano>(middle - start).count() / ops) + "ns"
+                         + " fused " + std::to_string(std::chrono::duration<double, std::nano>(end - middle).count() / ops) + "ns"
+                         + (identical ? " identical" : " mismatch"));
+    };
+
+    // ֱӹ: radiance.mut(f) * (cos * weight / pdf)
+    bench("direct light",
+          [&](int i) { return a[i].mut(b[i]) * (k[i] * 0.5 / k[count - 1 - i]); },
+          [&](int i) { return a[i].mut(b[i], k[i] * 0.5 / k[count - 1 - i]); });
+    // ·ۼ: L += beta.mut(emission) * weight
+    bench("path radiance",
+          [&](int i) { Vector3 L = c[i]; L += a[i].mut(b[i]) * k[i]; return L; },
+          [&](int i) { Vector3 L = c[i]; L.madd(a[i], b[i], k[i]); return L; });
+    // Blinn-Phong: ret += kd.mut(I / R2) * diffuse + ks.mut(I / R2) * specular
+    bench("blinn-phong",
+          [&](int i) { Vector3 ret = c[i]; ret += a[i].mut(c[i] / k[i]) * k[count - 1 - i]; ret += b[i].mut(c[i] / k[i]) * k[i]; return ret; },
+          [&](int i) { Vector3 ret = c[i]; Vector3 intensity = c[i] / k[i]; ret.madd(a[i], intensity, k[count - 1 - i]); ret.madd(b[i], intensity, k[i]); return ret; });
+    // դֵ
+    bench("interpolate",
+          [&](int i) { return (k[i] * a[i] + 0.25 * b[i] + 0.5 * c[i]) * k[count - 1 - i]; },
+          [&](int i) { return MathUtils::interpolate(k[i], 0.25, 0.5, a[i], b[i], c[i], k[count - 1 - i]); });
+
+    std::cout << std::endl << "ںܲԽ:" << std::endl;
+    for (const auto& line : report) {
+        std::cout << line << std::endl;
+    }
+    return ok;
+}
@@ -7,13 +7,24 @@
 
 #include "tool/vec.hpp"
 #include "tool/matrix.hpp"
+#ifdef ANYA_WITH_GUI
 #include <GLFW/glfw3.h>
+#endif
 
 void vecTest();
 void matrixTest();
+#ifdef ANYA_WITH_GUI
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow *window);
 int testGlfw();
+#endif
 void testRayTracer();
+bool testConvergence();
+bool testDirectLighting();
+bool testInstanceArea();
+bool testWavefront();
+bool testWideBVH();
+bool testBVHDepth();
+bool testVectorFusion();
 
 #endif //ANYA_ENGINE_TEST_H